@@ -1,15 +1,103 @@
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <locale.h>
 #include <time.h>
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <direct.h>
+#define fsync _commit
+#define chdir _chdir
+#define STDOUT_FILENO 1
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <netdb.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+extern char** environ;
+#endif
 
-#define URL_LEN 100
-#define CONTENT_LEN 500
-#define HASH_SIZE 100
-#define MAX_TABS 10
+#define MAX_URL_LEN 2048
+#define URL_INPUT_FORMAT "%2047s" // scanf width for MAX_URL_LEN buffers
+#define PAGE_MAX_LEN (1 << 20)   // longest page kept; longer bodies are cut
+#define PAGE_VIEW_LEN 4096       // page bytes shown on screen
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MIN_PAGE 64           // shorter pages are cached as they are
+#define CACHE_BYTE_BUDGET (1 << 20) // default memory budget of the page cache
+#define CACHE_MIN_SLOTS 64
+#define CACHE_MIGRATE_STEP 8        // old slots moved per operation while resizing
+#define CACHE_SLOT_MOVED 0xFFFFFFFFu // dist of a slot already migrated
+#define DISK_CACHE_BYTES (8 << 20)  // default size of the disk cache file
+#define DISK_CACHE_DATA "browser_cache.data"
+#define DISK_CACHE_INDEX "browser_cache.index"
+#define DISK_CACHE_MAGIC "SURFL2IX"
+#define DISK_CACHE_VERSION 2
+#define TAB_VIEW_ENTRIES 10     // tabs listed around the current one
+#define TAB_HIBERNATE_SECS 600  // default idle time before a tab hibernates
+#define TAB_NAV_DEPTH 64        // back/forward entries kept per tab
 #define MAX_SUGGESTIONS 5
+#define LAUNCH_BATCH_MAX 16      // URLs per launcher invocation
+#define LAUNCH_MAX_ARGS 16       // words in a --launcher command
+#define LAUNCH_MAX_CHILDREN 64   // launchers running before a spawn waits for the oldest
+#define PREFETCH_MAX_SUCCESSORS 16 // successors tracked per page
+#define PREFETCH_FANOUT 3        // pages warmed per idle point at most
+#define PREFETCH_MIN_COUNT 2     // times a transition is seen before it is predicted
+#define PREFETCH_MIN_PERCENT 20  // share of a page's transitions a prediction needs
+#define PREFETCH_BUDGET (16 << 10) // default cache bytes prefetched per idle point
+#define LOADER_MAX_WORKERS 16    // background loader threads at most
+#define HTTP_POOL_SIZE 8         // idle keep-alive connections kept open
+#define HTTP_TIMEOUT_MS 5000     // default connect/send/read timeout
+#define HTTP_HOST_LEN 256
+#define HTTP_LINE_LEN 8192       // longest status or header line
+#define HTTP_BUFFER 16384        // socket read buffer
+#define HTTP_SERVE_BLOCK 16384   // body bytes per send in the loopback server
+#define HTTP_SERVE_CLIENTS 64
+#define BOOKMARK_PAGE_SIZE 20
+#define HISTORY_VIEW_ENTRIES 10 // most recent entries shown under the page
+#define HISTORY_RECENT_VISITS 1024 // individual visits kept for the navigation model
+#define HISTORY_MAX_ENTRIES 10000  // default retention: distinct URLs kept
+#define HISTORY_MAX_DAYS 90        // default retention: days since the last visit
+#define HISTORY_SKIP_LEVELS 16     // levels of the time index
+#define POOL_SLAB_NODES 1024     // nodes per slab in the node pools
+#define INTERN_CHUNK_IDS 4096    // ids per intern directory chunk
+#define INTERN_MAX_CHUNKS 65536
+#define INTERN_ARENA_BYTES (1 << 16)
+#define NO_URL 0
+#define FRECENCY_HALF_LIFE 64.0  // visits after which a visit counts half
+#define DATA_FILE "browser_data.txt"
+#define PROFILE_FILE "browser_data.prof"
+#define PROFILE_MAGIC "SURFPROF"
+#define PROFILE_VERSION 2
+#define PROFILE_V1_HEADER_SIZE offsetof(ProfileHeader, recent_offset) // version 1 headers end there
+#define JOURNAL_FILE "browser_data.journal"
+#define JOURNAL_BATCH 32         // records per fsync group
+#define JOURNAL_FLUSH_SECS 1     // max age of an unsynced record
+#define COMPACT_MIN_RECORDS 1024 // journal size before compaction is considered
+#define LOAD_BUFFER (1 << 20)    // stdio buffer for the startup loader
+#define STATS_FILE "browser_stats.json"
+#define STATS_BUCKETS 48         // power-of-two latency buckets, in clock ticks
+#define TRACE_BUFFER_EVENTS 4096 // first allocation of a thread's trace buffer
 
 // ANSI color codes
 #define ANSI_COLOR_RED     "\x1b[31m"
@@ -26,625 +114,5061 @@ const char* HEADER_COLOR[] = { ANSI_COLOR_CYAN, ANSI_COLOR_BLUE, ANSI_COLOR_GREE
 const char* TEXT_COLOR[] = { ANSI_COLOR_YELLOW, ANSI_COLOR_CYAN, ANSI_COLOR_MAGENTA };
 const char* MENU_COLOR[] = { ANSI_COLOR_BLUE, ANSI_COLOR_MAGENTA, ANSI_COLOR_YELLOW };
 
-// Singly Linked List for History
-typedef struct HistoryNode {
-    char url[URL_LEN];
-    struct HistoryNode* next;
-} HistoryNode;
+// Slab Allocator for Fixed-Size Nodes
+typedef union PoolSlab {
+    union PoolSlab* next;
+    double align;     // nodes that follow the header stay 8-byte aligned
+} PoolSlab;
 
 typedef struct {
-    HistoryNode* head;
-    HistoryNode* current;
-    int size;
+    size_t node_size;
+    PoolSlab* slabs;
+    char* bump;       // next never-used node in the newest slab
+    char* bump_end;
+    void* free_list;  // freed nodes, linked through their first word
+    long allocs;
+    long frees;
+    long live;
+    long slab_count;
+} NodePool;
+
+// Interned URLs
+typedef unsigned int UrlId;
+
+typedef struct {
+    const char* text;
+    unsigned int length;
+    unsigned int awake_tabs; // awake tabs showing it; see setTabURL
+    unsigned long long hash; // hashURL(text)
+} InternedURL;
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    InternedURL* chunks[INTERN_MAX_CHUNKS]; // id -> URL, filled chunk by chunk
+    UrlId* slots;          // open addressing index from text to id
+    unsigned int capacity;
+    unsigned int count;    // ids 1..count are in use
+    size_t bytes;          // URL text stored
+    ArenaBlock* arenas;
+    char* arena_next;
+    size_t arena_left;
+} InternTable;
+
+// Radix Trie for URL Suggestions
+typedef struct SuggestEntry {
+    UrlId url;
+    int visits;
+    long last_visit;  // suggestion clock at the most recent visit
+    double score;     // log2 frecency, see recordVisit()
+} SuggestEntry;
+
+typedef struct TrieNode {
+    char* label;      // edge label leading to this node
+    int label_len;
+    struct TrieNode* child;
+    struct TrieNode* sibling;
+    SuggestEntry* entry; // set when a visited URL ends here
+    SuggestEntry* top[MAX_SUGGESTIONS]; // best completions in this subtree
+    int top_count;
+} TrieNode;
+
+typedef struct {
+    TrieNode* root;
+    long clock;       // visits recorded so far
+    int entries;      // distinct URLs
+    TrieNode** path;  // scratch for recordVisit(), grown with the trie's depth
+    int path_capacity;
+} SuggestIndex;
+
+// History Store
+// One entry per distinct URL in a skip list ordered by last visit, whose
+// bottom level is doubly linked
+typedef struct HistoryEntry {
+    UrlId url;
+    unsigned int visits;  // 0 once deleted, until the indexes are rebuilt
+    long long last_visit; // Unix time
+    unsigned long long stamp; // visit order, breaks ties between equal times
+    long seq;             // creation order, used by the search index
+    int level;            // skip list levels the entry is linked at
+    struct HistoryEntry** up; // next entries at levels 1 .. level - 1
+    struct HistoryEntry* prev;
+    struct HistoryEntry* next;
+} HistoryEntry;
+
+typedef struct {
+    UrlId url;
+    long long time;
+} VisitEvent;
+
+// Trigram Posting Lists for History Search
+typedef struct {
+    unsigned int key;     // three packed URL bytes, 0 marks an empty slot
+    int count;
+    int capacity;
+    HistoryEntry** nodes;  // entries containing the trigram, by seq
+} PostingList;
+
+typedef struct {
+    PostingList* slots;   // open addressing, capacity is a power of two
+    int capacity;
+    int used;
+} TrigramIndex;
+
+typedef struct {
+    UrlId url;
+    unsigned int count;
+} Transition;
+
+// Pages seen right after one page
+typedef struct {
+    Transition* next;
+    unsigned short count;
+    unsigned short capacity;
+    unsigned int total;      // transitions out of the page
+} TransitionRow;
+
+typedef struct {
+    TransitionRow* rows;     // indexed by UrlId
+    unsigned int capacity;
+    long edges;
+} TransitionModel;
+
+typedef struct {
+    HistoryEntry* oldest;   // least recently visited
+    HistoryEntry* newest;
+    HistoryEntry** by_url;  // indexed by UrlId
+    unsigned int url_capacity;
+    int size;               // distinct URLs
+    long visits;            // visits counted in the entries
+    long next_seq;
+    long pruned;            // entries dropped by retention
+    long deleted;           // entries removed by range deletion
+    HistoryEntry* skip_head[HISTORY_SKIP_LEVELS - 1]; // first entries at levels 1..
+    int levels;
+    unsigned long long stamp;
+    unsigned int seed;      // for skip list levels
+    HistoryEntry* dead;     // deleted entries the indexes still point to
+    int dead_count;
+    VisitEvent recent[HISTORY_RECENT_VISITS]; // ring of the latest visits
+    int recent_first;
+    int recent_count;
+    SuggestIndex suggest;
+    TrigramIndex search;
+    TransitionModel transitions;
+    NodePool nodes;
 } HistoryList;
 
-// Circular Doubly Linked List for Tabs
+// Indexed Tab Store
+// Tabs are kept in an array in the order they were opened, so a tab's
+// number never changes and switching to it is one array access. Awake
+// tabs are also linked from most to least recently active; the ones idle
+// for too long hibernate (see hibernateTabs).
+enum { TAB_IDLE, TAB_LOADING, TAB_READY, TAB_FAILED };
+
 typedef struct TabNode {
-    char url[URL_LEN];
-    struct TabNode* next;
-    struct TabNode* prev;
+    UrlId url;
+    int state;           // TAB_*, written by loader threads
+    double load_ms;      // duration of the last background load
+    double last_active;  // nowMs() when the tab was last shown
+    int hibernated;      // its page was dropped from the memory cache
+    UrlId* nav;          // pages shown in this tab, a ring of nav_capacity
+    int nav_capacity;    // power of two, at most TAB_NAV_DEPTH
+    int nav_first;       // ring slot of the oldest page
+    int nav_count;
+    int nav_pos;         // page shown, counted from the oldest
+    struct TabNode* lru_prev;
+    struct TabNode* lru_next;
 } TabNode;
 
 typedef struct {
-    TabNode* current;
+    TabNode** items;     // open tabs; tab number i is items[i - 1]
     int tab_count;
+    int capacity;
+    int current_index;   // position of current in items
+    TabNode* current;
+    TabNode* lru_head;   // awake tabs, most recently active first
+    TabNode* lru_tail;
+    int hibernated;      // tabs asleep right now
+    long hibernations;
+    long restores;
+    NodePool nodes;
 } TabList;
 
+// Page text of any length
+typedef struct {
+    char* text;                 // NUL-terminated
+    size_t length;
+    size_t capacity;
+    size_t stored;              // cache entry size, set by cache hits
+    double decode_us;           // time spent decoding it
+} Page;
+
 // Hash Table for URL Caching
 typedef struct CacheNode {
-    char url[URL_LEN];
-    char content[CONTENT_LEN];
-    struct CacheNode* next;
+    UrlId url;
+    unsigned char* data;        // page, LZ-compressed when that is smaller
+    uint32_t stored;            // bytes at data
+    uint32_t length;            // page length
+    unsigned long long hash;    // urlHash(url)
+    struct CacheNode* lru_prev; // more recently used
+    struct CacheNode* lru_next; // less recently used
+    int prefetched;             // warmed by prefetchPages, not requested yet
 } CacheNode;
 
 typedef struct {
-    CacheNode* table[HASH_SIZE];
-} HashTable;
+    CacheNode* node;    // NULL when empty
+    unsigned int hash;  // low bits of node->hash
+    unsigned int dist;  // probe distance from the home slot
+} CacheSlot;
+
+typedef struct {
+    CacheSlot* slots;
+    unsigned int capacity; // power of two
+    unsigned int count;
+} SlotTable;
+
+// Disk cache record: header, URL text, page text, padding to 8 bytes
+typedef struct {
+    uint64_t key;            // urlHash of the URL, never 0
+    uint32_t crc;            // CRC32 of URL and page
+    uint32_t url_length;
+    uint32_t content_length; // page length
+    uint32_t stored_length;  // cache blob length, as in CacheNode
+    uint32_t length;         // whole record
+    uint32_t reserved;
+} DiskRecord;
+
+typedef struct {
+    uint64_t key;            // 0 when empty
+    uint64_t offset;         // record position in the data file
+} DiskSlot;
+
+// DISK_CACHE_INDEX: header followed by count DiskSlots
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t limit;
+    uint64_t evict_pos;
+} DiskIndexHeader;
 
-// Stack for Backtracking
-typedef struct StackNode {
-    char url[URL_LEN];
-    struct StackNode* next;
-} StackNode;
+typedef struct DiskCache {
+    char* data;              // mapped data file, NULL when disabled
+    uint64_t capacity;
+    uint64_t head;           // next write position
+    uint64_t limit;          // end of the previous lap's records
+    uint64_t evict_pos;      // first previous-lap record not yet dropped
+    DiskSlot* slots;         // index, open addressing by key
+    unsigned int slot_capacity;
+    unsigned int count;
+    uint64_t live_bytes;     // bytes of indexed records
+    long hits;
+    long misses;
+    long spills;
+    long drops;              // records overwritten by the ring
+    long corrupt;            // records that failed their checksum
+} DiskCache;
 
 typedef struct {
-    StackNode* top;
-} BackStack;
+    SlotTable table;
+    SlotTable old;         // previous table while a resize is in progress
+    unsigned int migrate_pos;
+    CacheNode* lru_head;  // most recently used
+    CacheNode* lru_tail;  // next to be evicted
+    size_t bytes;
+    size_t byte_budget;
+    int entries;
+    long hits;
+    long misses;
+    long evictions;
+    long prefetches;
+    long prefetch_hits;
+    long prefetch_wasted;       // prefetched pages evicted unused
+    size_t prefetch_wasted_bytes;
+    unsigned long long page_bytes;   // pages cached, before compression
+    unsigned long long stored_bytes; // the same pages as stored
+    long decodes;
+    double decode_ms;
+    NodePool nodes;
+    pthread_mutex_t lock;       // taken by the cache* entry points
+    DiskCache* disk;            // second level, or NULL
+} HashTable;
 
-// Binary Search Tree for Bookmarks
+// AVL Tree for Bookmarks
 typedef struct BookmarkNode {
-    char url[URL_LEN];
+    UrlId url;
     struct BookmarkNode* left;
     struct BookmarkNode* right;
+    int height;
+    int size;         // nodes in this subtree, for paging
 } BookmarkNode;
 
+// State of one collectBookmarks() walk
+typedef struct {
+    int first;        // bookmarks still to skip
+    int limit;
+    int count;
+    BookmarkNode** out;
+} BookmarkPage;
+
+// Append-only journal for history and bookmark records
+typedef struct {
+    FILE* fp;
+    long epoch;            // snapshot generation the journal belongs to
+    int pending;           // records appended since the last fsync
+    time_t oldest_pending; // append time of the oldest unsynced record
+    long records;          // records in the journal since the last snapshot
+    long snapshot_records; // records in the current snapshot
+    int stale;             // the file on disk belongs to another epoch
+} Journal;
+
+// Binary Profile Format
+// [header][ProfileString x string_count][NUL-terminated URL text]
+// [ProfileHistory x history_count, least recently visited first]
+// [uint32 bookmarks, in URL order][ProfileVisit x recent_count, oldest first]
+// History, bookmark and visit records refer to URLs by their index in the
+// string table. Fields are in host byte order. Version 1 stored one uint32
+// string index per visit in place of the history records, and no recent
+// visits; it is still read.
+typedef struct {
+    char magic[8];           // PROFILE_MAGIC, not NUL-terminated
+    uint32_t version;
+    uint32_t header_size;
+    int64_t epoch;
+    uint32_t string_count;
+    uint32_t history_count;
+    uint32_t bookmark_count;
+    uint32_t recent_count;
+    uint64_t strings_offset;
+    uint64_t text_offset;
+    uint64_t text_bytes;
+    uint64_t history_offset;
+    uint64_t bookmark_offset;
+    uint64_t recent_offset;
+} ProfileHeader;
+
+typedef struct {
+    uint32_t string;
+    uint32_t visits;
+    int64_t last_visit;      // Unix time
+} ProfileHistory;
+
+typedef struct {
+    uint32_t string;
+    uint32_t reserved;
+    int64_t time;            // Unix time
+} ProfileVisit;
+
+typedef struct {
+    uint64_t offset;         // into the text section
+    uint32_t length;
+    uint32_t reserved;
+    uint64_t hash;           // hashURL() of the text
+} ProfileString;
+
+// Startup load measurements
+typedef struct {
+    long history_records;
+    long bookmark_records;
+    double millis;
+} LoadStats;
+
+// Instrumented operations
+enum { STAT_FETCH, STAT_SAVE, STAT_HISTORY_ADD, STAT_SUGGEST, STAT_OPEN, STAT_LAUNCH, STAT_TIMERS };
+
+// Latency histogram: bucket b counts operations that took [2^b, 2^(b+1))
+// ticks of statTicks()
+typedef struct {
+    long count;
+    unsigned long long total_ticks;
+    unsigned long long max_ticks;
+    long buckets[STATS_BUCKETS];
+} LatencyHistogram;
+
+typedef struct {
+    LatencyHistogram timers[STAT_TIMERS]; // main thread only
+    unsigned long long base_ticks;        // statTicks() and nowMs() at startup,
+    double base_ms;                       // to convert ticks to time
+    long nodes_allocated;                 // updated atomically
+    unsigned long long profile_bytes;     // written to PROFILE_FILE
+    unsigned long long journal_bytes;     // written to JOURNAL_FILE
+} Stats;
+
+// Trace span boundary; name is a string literal
+typedef struct {
+    const char* name;
+    unsigned long long ticks;  // statTicks()
+    char phase;                // 'B' begin, 'E' end
+} TraceEvent;
+
+// Events of one thread, written only by that thread
+typedef struct TraceBuffer {
+    TraceEvent* events;
+    int count;
+    int capacity;
+    int tid;
+    const char* thread_name;
+    long dropped;
+    struct TraceBuffer* next;
+} TraceBuffer;
+
+// Latency samples of one scripted command
+typedef struct {
+    const char* name;
+    double* samples;  // microseconds
+    int count;
+    int capacity;
+} OpTimings;
+
+// Screen regions, in the order they appear on screen
+enum { REGION_HEADER, REGION_BODY, REGION_TABS, REGION_HISTORY, REGION_MENU, REGION_COUNT };
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} UiBuffer;
+
+// Frame being composed and the frame currently on screen
+typedef struct {
+    int enabled;                     // off: uiPrintf writes straight to stdout
+    UiBuffer regions[REGION_COUNT];
+    UiBuffer shown[REGION_COUNT];
+    UiBuffer output;                 // bytes of the next write()
+    int region;                      // region receiving output
+    int fresh;                       // frame started but not flushed yet
+    int flushed_region;              // how much of this frame is on screen
+    size_t flushed_length;
+    int input_region;                // first region input was read in
+    int inputs;                      // input lines echoed in this frame
+    int shown_rows;                  // rows used on screen, for scroll detection
+    long frames;
+    long full_redraws;
+} Frame;
+
+// Queued opens for the external browser
+typedef struct {
+    char* command;                      // --launcher / SURF_LAUNCHER, split into argv
+    char* argv[LAUNCH_MAX_ARGS];
+    int argc;
+    char* pending[LAUNCH_BATCH_MAX];    // formatted URLs waiting for the idle point
+    int pending_count;
+    int children[LAUNCH_MAX_CHILDREN];  // pids of launchers not yet reaped
+    int child_count;
+    long launches;
+    long urls;
+    long coalesced;                     // opens dropped as duplicates of a queued URL
+    long failures;
+} Launcher;
+
+// Idle keep-alive connection
+typedef struct {
+    char host[HTTP_HOST_LEN];
+    int port;
+    int fd;              // -1 when the slot is empty
+    double last_used;
+} HttpConnection;
+
+typedef struct {
+    HttpConnection pool[HTTP_POOL_SIZE];
+    pthread_mutex_t lock; // guards pool; counters are updated atomically
+    int timeout_ms;
+    int keep_alive;      // 0: one connection per request
+    long requests;
+    long connects;
+    long reuses;
+    long retries;
+    long failures;
+    unsigned long long bytes;       // received, headers included
+    unsigned long long body_bytes;
+} HttpClient;
+
+// Buffered reads from one connection
+typedef struct {
+    int fd;
+    char buffer[HTTP_BUFFER];
+    size_t pos;
+    size_t length;
+    size_t received;
+} HttpReader;
+
+// Response body sink: keeps the first limit bytes, counts the rest
+typedef struct {
+    Page* page;
+    size_t limit;
+    unsigned long long total;
+} HttpBody;
+
+// Background page loads
+typedef struct {
+    UrlId url;
+    TabNode* tab;        // shows the load state, or NULL
+    int prefetch;        // warming a predicted page, counted against the budget
+} LoadTask;
+
+// Growable ring of tasks; the owner works at the bottom, thieves at the top
+typedef struct {
+    LoadTask* tasks;
+    int capacity;        // power of two
+    long top;
+    long bottom;
+    pthread_mutex_t lock;
+} LoadDeque;
+
+typedef struct LoaderWorker {
+    pthread_t thread;
+    LoadDeque deque;
+    struct LoaderPool* pool;
+    int index;
+    long tasks;
+    long steals;
+} LoaderWorker;
+
+typedef struct LoaderPool {
+    LoaderWorker workers[LOADER_MAX_WORKERS];
+    int count;
+    int next;            // round-robin submit target
+    int running;
+    long queued;         // submitted and not yet taken by a worker
+    long submitted;
+    long completed;
+    long prefetching;     // prefetch tasks not finished yet
+    size_t prefetch_spent; // cache bytes stored by the current prefetch round
+    HashTable* cache;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} LoaderPool;
+
 // Browser selection (0: Default, 1: Edge, 2: Chrome)
 int browser_choice = 0;
 
+// Set by --script: no rendering and no external browser launches.
+int headless = 0;
+FILE* session_log = NULL; // --record target
+
+Journal journal = { NULL, 0, 0, 0, 0, 0, 0 };
+InternTable url_table;
+NodePool bookmark_pool = { sizeof(BookmarkNode), NULL, NULL, NULL, NULL, 0, 0, 0, 0 };
+LoadStats load_stats = { 0, 0, 0.0 };
+Frame ui;
+Launcher launcher;
+HttpClient http;
+LoaderPool loader;
+DiskCache disk_cache;
+size_t disk_cache_bytes = DISK_CACHE_BYTES;
+size_t prefetch_budget = PREFETCH_BUDGET;
+int history_limit = HISTORY_MAX_ENTRIES;
+long long history_max_age = HISTORY_MAX_DAYS * 86400LL;
+double hibernate_after_ms = TAB_HIBERNATE_SECS * 1000.0;
+Stats stats;
+const char* stats_path = STATS_FILE;
+const char* STAT_NAMES[STAT_TIMERS] = { "fetch", "save", "history.add", "suggest", "open", "launch" };
+
+int tracing = 0;                     // set by --trace
+const char* trace_path = NULL;
+TraceBuffer* trace_buffers = NULL;   // every thread's buffer, pushed lock-free
+int trace_next_tid = 0;
+__thread TraceBuffer* trace_local = NULL;
+const char* MENU_ACTIONS[] = {
+    "", "Enter New URL", "Refresh Page", "Go Back", "Go Home", "New Tab", "Switch Tab", "Set Browser",
+    "Clear History", "Search History", "Change Theme", "Add Bookmark", "View Bookmarks", "Reload All Tabs",
+    "Go Forward", "Statistics", "Exit Browser",
+};
+
+// Instrumentation hooks; building with -DBROWSER_NO_STATS compiles them out.
+#ifdef BROWSER_NO_STATS
+#define STAT_START() 0
+#define STAT_STOP(timer, start) ((void)(start))
+#define STAT_ADD(counter, n) ((void)0)
+#define TRACE_BEGIN(name) ((void)(name))
+#define TRACE_END(name) ((void)(name))
+#define TRACE_THREAD(name) ((void)0)
+#else
+#define STAT_START() statTicks()
+#define STAT_STOP(timer, start) statRecord(&stats.timers[timer], start)
+#define STAT_ADD(counter, n) __atomic_fetch_add(&stats.counter, (n), __ATOMIC_RELAXED)
+#define TRACE_BEGIN(name) (tracing ? traceEvent(name, 'B') : (void)0)
+#define TRACE_END(name) (tracing ? traceEvent(name, 'E') : (void)0)
+#define TRACE_THREAD(name) (tracing ? traceThreadName(name) : (void)0)
+#endif
+
 // Function Prototypes
+double nowMs();
+unsigned long long statTicks();
+void statInit();
+double statNsPerTick();
+void statRecord(LatencyHistogram* histogram, unsigned long long start);
+double statPercentile(const LatencyHistogram* histogram, double fraction, double ns_per_tick);
+void showStats(HashTable* cache);
+int writeStats(const char* path, HashTable* cache);
+TraceBuffer* traceBuffer();
+void traceEvent(const char* name, char phase);
+void traceThreadName(const char* name);
+int writeTrace(const char* path);
+void initPool(NodePool* pool, size_t node_size);
+void* poolAlloc(NodePool* pool);
+void poolFree(NodePool* pool, void* node);
+void poolReleaseAll(NodePool* pool);
+InternedURL* urlEntry(UrlId id);
+const char* urlText(UrlId id);
+unsigned long long urlHash(UrlId id);
+UrlId findURL(const char* url);
+char* internArenaAlloc(size_t size);
+UrlId addInternedURL(const char* text, unsigned int length, unsigned long long h);
+UrlId internURL(const char* url);
+void freeURLs();
+void uiInit();
+int uiAppend(UiBuffer* buffer, const char* data, size_t length);
+void uiPrintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void uiRegion(int region);
+int terminalSize(int* rows, int* cols);
+void uiAdvance(const char* text, size_t length, int cols, int* row, int* col);
+void uiWrite(const char* data, size_t length);
+void uiFlush();
+void uiInput();
 void clearScreen();
 void showHeader();
-void showFakeFeatures();
+void showFakeFeatures(HashTable* cache);
 void initHistory(HistoryList* history);
+HistoryEntry* findHistoryEntry(HistoryList* history, UrlId url);
+HistoryEntry** timeLink(HistoryList* history, HistoryEntry* entry, int level);
+void findTimePredecessors(HistoryList* history, long long time, unsigned long long stamp, HistoryEntry** update);
+void linkHistoryEntry(HistoryList* history, HistoryEntry* entry);
+void unlinkHistoryEntry(HistoryList* history, HistoryEntry* entry);
+HistoryEntry* touchHistoryEntry(HistoryList* history, UrlId url, unsigned int visits, long long when);
+void pushRecentVisit(HistoryList* history, UrlId url, long long when);
+void appendHistory(HistoryList* history, UrlId url, long long when);
 void addToHistory(HistoryList* history, const char* url);
+void rebuildHistoryIndexes(HistoryList* history);
+int pruneHistory(HistoryList* history, long long now);
+int findHistoryRange(HistoryList* history, long long from, long long to, HistoryEntry** out, int max);
+int deleteHistoryRange(HistoryList* history, long long from, long long to);
 void showHistory(HistoryList* history);
+void initSuggestIndex(SuggestIndex* index);
+TrieNode* newTrieNode(const char* label, int label_len);
+void updateTopSuggestions(TrieNode* node, SuggestEntry* entry);
+void refillTopSuggestions(TrieNode* node);
+int pushSuggestPath(SuggestIndex* index, int depth, TrieNode* node);
+void recordVisit(SuggestIndex* index, UrlId url, unsigned int visits);
+int findSuggestions(SuggestIndex* index, const char* prefix, SuggestEntry** out);
+void forgetVisits(SuggestIndex* index, UrlId url);
+void freeTrie(TrieNode* node);
+void freeSuggestIndex(SuggestIndex* index);
+void initTrigramIndex(TrigramIndex* index);
+void initTransitionModel(TransitionModel* model);
+void recordTransition(TransitionModel* model, UrlId from, UrlId to);
+int predictNext(TransitionModel* model, UrlId from, UrlId* out, int max);
+void freeTransitionModel(TransitionModel* model);
+void prefetchPages(LoaderPool* pool, HistoryList* history, UrlId current);
+unsigned int trigramKey(const char* s);
+PostingList* findPostingList(TrigramIndex* index, unsigned int key);
+PostingList* getPostingList(TrigramIndex* index, unsigned int key);
+void indexHistoryEntry(TrigramIndex* index, HistoryEntry* node);
+HistoryEntry** findInHistory(HistoryList* history, const char* keyword, int* count);
+void freeTrigramIndex(TrigramIndex* index);
+void freeHistory(HistoryList* history);
 void clearHistory(HistoryList* history);
-void searchHistory(HistoryList* history, TabList* tabs, HashTable* cache, BackStack* stack);
+void clearHistoryRange(HistoryList* history, long long seconds);
+void searchHistory(HistoryList* history, TabList* tabs, HashTable* cache);
 void initTabs(TabList* tabs);
 void addTab(TabList* tabs, const char* url);
+void activateTab(TabList* tabs, TabNode* tab);
+void setTabURL(TabNode* tab, UrlId url);
+void tabNavigate(TabNode* tab, UrlId url);
+UrlId tabStep(TabNode* tab, int delta);
 void switchTab(TabList* tabs, int index);
+void hibernateTabs(TabList* tabs, HashTable* cache);
 void showTabs(TabList* tabs);
+void freeTabs(TabList* tabs);
+int loaderWorkerCount();
+void pushLoadTask(LoadDeque* deque, LoadTask task);
+int popLoadTask(LoadDeque* deque, LoadTask* task);
+int stealLoadTask(LoadDeque* deque, LoadTask* task);
+void runLoadTask(LoaderPool* pool, LoadTask* task);
+void* loaderWorker(void* arg);
+int initLoaderPool(LoaderPool* pool, HashTable* cache, int workers);
+void submitLoad(LoaderPool* pool, UrlId url, TabNode* tab, int prefetch);
+void waitLoaderPool(LoaderPool* pool);
+void shutdownLoaderPool(LoaderPool* pool);
+void refreshAllTabs(LoaderPool* pool, TabList* tabs);
+int pageReserve(Page* page, size_t length);
+void pageSet(Page* page, const char* text, size_t length);
+void pagePrintf(Page* page, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void freePage(Page* page);
+void lzPutLength(unsigned char** out, size_t length);
+int lzEmit(unsigned char** out, unsigned char* end, const unsigned char* literals, size_t literal_length,
+           size_t offset, size_t match_length);
+size_t lzCompress(const unsigned char* in, size_t length, unsigned char* out, size_t capacity);
+int lzGetLength(const unsigned char** in, const unsigned char* end, size_t* length);
+int lzDecompress(const unsigned char* in, size_t size, unsigned char* out, size_t length);
+unsigned char* encodePage(const char* text, size_t length, uint32_t* stored);
+int decodePage(const unsigned char* data, uint32_t stored, uint32_t length, Page* page);
 void initHashTable(HashTable* cache);
-unsigned int hash(const char* url);
-void addToCache(HashTable* cache, const char* url, const char* content);
-char* getFromCache(HashTable* cache, const char* url);
-void initBackStack(BackStack* stack);
-void pushBackStack(BackStack* stack, const char* url);
-char* popBackStack(BackStack* stack);
+unsigned long long hashURL(const char* url);
+int initSlotTable(SlotTable* table, unsigned int capacity);
+void insertSlot(SlotTable* table, CacheNode* node);
+CacheSlot* findSlot(SlotTable* table, unsigned long long hash, UrlId url);
+void removeSlot(SlotTable* table, CacheSlot* slot, int tombstone);
+void migrateCacheSlots(HashTable* cache, unsigned int steps);
+void growCache(HashTable* cache);
+CacheNode* findCacheNode(HashTable* cache, UrlId url);
+CacheNode* addEncodedToCache(HashTable* cache, UrlId url, unsigned char* data, uint32_t stored, uint32_t length);
+CacheNode* addToCache(HashTable* cache, UrlId url, const char* content, size_t length);
+void touchCacheNode(HashTable* cache, CacheNode* node);
+void unlinkCacheNode(HashTable* cache, CacheNode* node);
+void evictCacheNode(HashTable* cache, CacheNode* node);
+void setCacheBudget(HashTable* cache, size_t bytes);
+int getFromCache(HashTable* cache, UrlId url, Page* page);
+int cacheLookup(HashTable* cache, UrlId url, Page* page);
+int cacheContains(HashTable* cache, UrlId url);
+size_t cacheDrop(HashTable* cache, UrlId url);
+size_t storeInCache(HashTable* cache, UrlId url, const Page* page, int prefetched);
+void freeCache(HashTable* cache);
+uint32_t crc32Update(uint32_t crc, const void* data, size_t length);
+uint64_t diskKey(UrlId url);
+DiskSlot* findDiskSlot(DiskCache* disk, uint64_t key);
+DiskRecord* diskRecordAt(DiskCache* disk, uint64_t offset);
+int setDiskSlot(DiskCache* disk, uint64_t key, uint64_t offset);
+void removeDiskSlot(DiskCache* disk, DiskSlot* slot);
+void dropDiskRecords(DiskCache* disk, uint64_t end);
+int loadDiskIndex(DiskCache* disk);
+int openDiskCache(DiskCache* disk, size_t capacity);
+int diskCacheStore(DiskCache* disk, UrlId url, const unsigned char* data, uint32_t stored, uint32_t length);
+unsigned char* diskCacheLoad(DiskCache* disk, UrlId url, uint32_t* stored, uint32_t* length);
+void closeDiskCache(DiskCache* disk);
+void spillCache(HashTable* cache);
+void reapLaunchers();
+void initLauncher(const char* command);
 void openURLInBrowser(const char* url);
+int spawnLauncher(char* const argv[]);
+void flushLaunches();
+void initHttpClient();
+int parseHttpURL(const char* url, char* host, int* port, char* path, size_t path_size);
+int httpWait(int fd, short events);
+int httpConnect(const char* host, int port);
+int httpAcquire(const char* host, int port);
+void httpRelease(const char* host, int port, int fd);
+void closeHttpConnections();
+int httpSendAll(int fd, const char* data, size_t length);
+long httpFill(HttpReader* reader);
+int httpReadLine(HttpReader* reader, char* line, size_t size);
+int httpReadBody(HttpReader* reader, long long count, HttpBody* body);
+int httpExchange(int fd, const char* request, size_t request_length, HttpBody* body, int* reusable, int* got_bytes);
+int httpFetch(const char* url, Page* page);
+int openHttpListener(int port, int* bound_port);
+int serveHttpRequest(int fd, const char* request);
+void runHttpServer(int listen_fd);
+int serveHttp(int port);
+void generatePage(const char* url, Page* page);
+int producePage(UrlId url, Page* page);
+int loadPage(HashTable* cache, UrlId url, Page* page);
 void fetchContent(HashTable* cache, const char* url);
 void showMenu();
 int validateURL(const char* url);
 void suggestURLs(HistoryList* history, const char* prefix);
-void enterURL(HistoryList* history, TabList* tabs, HashTable* cache, BackStack* stack);
-void goBack(HistoryList* history, TabList* tabs, BackStack* stack);
-void goHome(HistoryList* history, TabList* tabs, HashTable* cache, BackStack* stack);
+void navigateTo(HistoryList* history, TabList* tabs, const char* url, int new_tab);
+void enterURL(HistoryList* history, TabList* tabs, HashTable* cache, int new_tab);
+void stepCurrentTab(HistoryList* history, TabList* tabs, HashTable* cache, int delta);
+void goHome(HistoryList* history, TabList* tabs, HashTable* cache);
 void setBrowser();
 void changeTheme();
+void recordAction(const char* command, const char* arg);
+int compareDoubles(const void* a, const void* b);
+void addTiming(OpTimings* op, double micros);
+int runScript(const char* path, HistoryList* history, TabList* tabs, HashTable* cache, BookmarkNode** root);
+const char* absolutePath(const char* path);
 BookmarkNode* initBookmarks();
+int bookmarkHeight(BookmarkNode* node);
+int bookmarkCount(BookmarkNode* node);
+void updateBookmarkNode(BookmarkNode* node);
+BookmarkNode* rotateBookmarkRight(BookmarkNode* node);
+BookmarkNode* rotateBookmarkLeft(BookmarkNode* node);
+BookmarkNode* balanceBookmarks(BookmarkNode* node);
 BookmarkNode* insertBookmark(BookmarkNode* root, const char* url);
 int bookmarkExists(BookmarkNode* root, const char* url);
+BookmarkNode* bookmarkAt(BookmarkNode* root, int index);
+int collectBookmarks(BookmarkNode* root, int first, int limit, BookmarkNode** out);
 void addBookmark(BookmarkNode** root, TabList* tabs);
-void viewBookmarks(BookmarkNode* root, HistoryList* history, TabList* tabs, HashTable* cache, BackStack* stack);
+void viewBookmarks(BookmarkNode* root, HistoryList* history, TabList* tabs, HashTable* cache);
 void freeBookmarks(BookmarkNode* root);
+long writeProfile(const char* path, HistoryList* history, BookmarkNode* root, long epoch);
 void saveData(HistoryList* history, BookmarkNode* root);
+const char* mapProfile(const char* path, size_t* size);
+void unmapProfile(const char* data, size_t size);
+int profileRangeFits(uint64_t offset, uint64_t count, uint64_t record_size, uint64_t end);
+BookmarkNode* buildBookmarks(const UrlId* ids, int count);
+long loadProfile(const char* path, HistoryList* history, BookmarkNode** root, long* epoch);
+int readRecord(FILE* fp, char** line, size_t* size);
+long replayTextFile(const char* path, HistoryList* history, BookmarkNode** root, long* epoch, int is_journal);
 void loadData(HistoryList* history, BookmarkNode** root);
+int convertProfile(const char* text_path, const char* profile_path);
+void openJournal();
+void journalRecord(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void journalAppend(char type, const char* url);
+void journalVisit(const char* url, long long when);
+void journalSync();
+void compactData(HistoryList* history, BookmarkNode* root);
 
-void clearScreen() {
+// Monotonic wall clock in milliseconds
+double nowMs() {
     #ifdef _WIN32
-        system("cls");
+        LARGE_INTEGER freq, now;
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&now);
+        return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
     #else
-        system("clear");
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
     #endif
 }
 
-void showHeader() {
-    clearScreen();
-    printf("%s", HEADER_COLOR[theme]);
-    printf("=============================================\n");
-    printf("|      Pranav's Surf Browser v4.1           |\n");
-    printf("|  Powered by Advanced C Data Structures    |\n");
-    printf("=============================================\n");
-    printf("%s", ANSI_COLOR_RESET);
-    printf("\n");
-}
-
-void showFakeFeatures() {
-    printf("%s", TEXT_COLOR[theme]);
-    printf("--- Advanced Features ---\n");
-    printf("  * SSL Encryption: Secure Browsing Enabled\n");
-    printf("  * CloudSync Serverless Backend: Active\n");
-    printf("  * Firewall Protection: Intrusion Blocked\n");
-    printf("  * AI-Powered Threat Detection: Running\n");
-    printf("-------------------------\n\n");
-    printf("%s", ANSI_COLOR_RESET);
+// Instrumentation
+// Hot paths are timed into fixed power-of-two histograms, so recording is
+// two timestamp reads and a few integer operations with no allocation, and
+// percentiles are read back to within a factor of two. On x86 timestamps
+// come from the cycle counter, which costs a fraction of a clock_gettime()
+// call, and are converted to time against the monotonic clock only when
+// reported. showStats() is the Statistics menu entry; writeStats() dumps
+// everything as JSON at exit.
+unsigned long long statTicks() {
+    #if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+    #else
+        return (unsigned long long)(nowMs() * 1e6);
+    #endif
 }
 
-// History Management
-void initHistory(HistoryList* history) {
-    history->head = NULL;
-    history->current = NULL;
-    history->size = 0;
+void statInit() {
+    stats.base_ticks = statTicks();
+    stats.base_ms = nowMs();
 }
 
-void addToHistory(HistoryList* history, const char* url) {
-    HistoryNode* newNode = (HistoryNode*)malloc(sizeof(HistoryNode));
-    if (!newNode) {
-        printf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
-        return;
+double statNsPerTick() {
+    #if defined(__x86_64__) || defined(__i386__)
+        double ms = nowMs() - stats.base_ms;
+        unsigned long long ticks = statTicks() - stats.base_ticks;
+        return ms > 0 && ticks > 0 ? ms * 1e6 / ticks : 1.0;
+    #else
+        return 1.0;
+    #endif
+}
+
+void statRecord(LatencyHistogram* histogram, unsigned long long start) {
+    unsigned long long ticks = statTicks() - start;
+    int bucket = ticks > 1 ? 63 - __builtin_clzll(ticks) : 0;
+    if (bucket >= STATS_BUCKETS) bucket = STATS_BUCKETS - 1;
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_ticks += ticks;
+    if (ticks > histogram->max_ticks) histogram->max_ticks = ticks;
+}
+
+// Estimates a percentile, in ns, as the middle of the bucket it falls in.
+double statPercentile(const LatencyHistogram* histogram, double fraction, double ns_per_tick) {
+    long rank = (long)ceil(histogram->count * fraction);
+    if (rank < 1) rank = 1;
+    long seen = 0;
+    double max = (double)histogram->max_ticks;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        seen += histogram->buckets[b];
+        if (seen >= rank) {
+            double middle = ldexp(1.5, b);
+            return (middle < max ? middle : max) * ns_per_tick;
+        }
     }
-    strncpy(newNode->url, url, URL_LEN - 1);
-    newNode->url[URL_LEN - 1] = '\0';
-    newNode->next = NULL;
+    return max * ns_per_tick;
+}
 
-    if (history->head == NULL) {
-        history->head = newNode;
-        history->current = newNode;
-    } else {
-        history->current->next = newNode;
-        history->current = newNode;
+void showStats(HashTable* cache) {
+    uiRegion(REGION_BODY);
+    uiPrintf("%s--- Statistics ---\n", TEXT_COLOR[theme]);
+    #ifdef BROWSER_NO_STATS
+        uiPrintf("Instrumentation is compiled out (BROWSER_NO_STATS).\n");
+    #else
+    double us_per_tick = statNsPerTick() / 1000.0;
+    uiPrintf("%-12s %8s %10s %10s %10s %10s %10s\n", "op", "count", "mean_us", "p50_us", "p90_us", "p99_us", "max_us");
+    for (int i = 0; i < STAT_TIMERS; i++) {
+        const LatencyHistogram* h = &stats.timers[i];
+        if (h->count == 0) continue;
+        uiPrintf("%-12s %8ld %10.2f %10.2f %10.2f %10.2f %10.2f\n", STAT_NAMES[i], h->count,
+                 (double)h->total_ticks / h->count * us_per_tick, statPercentile(h, 0.50, us_per_tick),
+                 statPercentile(h, 0.90, us_per_tick), statPercentile(h, 0.99, us_per_tick),
+                 h->max_ticks * us_per_tick);
     }
-    history->size++;
-    saveData(history, NULL); // Save history after adding
+    uiPrintf("Written: %llu profile bytes, %llu journal bytes\n", stats.profile_bytes, stats.journal_bytes);
+    uiPrintf("Nodes allocated: %ld\n", __atomic_load_n(&stats.nodes_allocated, __ATOMIC_RELAXED));
+    #endif
+    uiPrintf("Cache: %ld hits, %ld misses\n", cache->hits, cache->misses);
+    uiPrintf("Launches: %ld (%ld URLs, %ld coalesced, %ld failed)\n",
+             launcher.launches, launcher.urls, launcher.coalesced, launcher.failures);
+    uiPrintf("------------------\n\n%s", ANSI_COLOR_RESET);
 }
 
-void showHistory(HistoryList* history) {
-    printf("%s", TEXT_COLOR[theme]);
-    printf("Browsing History:\n");
-    printf("----------------\n");
-    if (history->size == 0) {
-        printf("No history yet!\n");
-    } else {
-        HistoryNode* temp = history->head;
-        int i = 1;
-        while (temp) {
-            printf("%s%d. %s\n", (temp == history->current) ? "> " : "  ", i++, temp->url);
-            temp = temp->next;
+// Writes timers and counters to path as one JSON object. Returns 0 on
+// success; nothing is written when instrumentation is compiled out.
+int writeStats(const char* path, HashTable* cache) {
+    #ifdef BROWSER_NO_STATS
+        (void)cache;
+        path = NULL;
+    #endif
+    if (!path || !*path) return 0;
+    FILE* fp = fopen(path, "w");
+    if (!fp) return -1;
+    double ns_per_tick = statNsPerTick();
+    fprintf(fp, "{\"timers\":{");
+    for (int i = 0; i < STAT_TIMERS; i++) {
+        const LatencyHistogram* h = &stats.timers[i];
+        fprintf(fp, "%s\n \"%s\":{\"count\":%ld,\"mean_ns\":%.1f,\"p50_ns\":%.1f,\"p90_ns\":%.1f,"
+                    "\"p99_ns\":%.1f,\"max_ns\":%.1f,\"buckets\":[", i ? "," : "", STAT_NAMES[i], h->count,
+                h->count ? (double)h->total_ticks / h->count * ns_per_tick : 0.0,
+                statPercentile(h, 0.50, ns_per_tick), statPercentile(h, 0.90, ns_per_tick),
+                statPercentile(h, 0.99, ns_per_tick), h->max_ticks * ns_per_tick);
+        // [lower bound in ns, count] for every non-empty bucket
+        int first = 1;
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            if (h->buckets[b] == 0) continue;
+            fprintf(fp, "%s[%.0f,%ld]", first ? "" : ",", ldexp(ns_per_tick, b), h->buckets[b]);
+            first = 0;
         }
+        fprintf(fp, "]}");
     }
-    printf("----------------\n\n");
-    printf("%s", ANSI_COLOR_RESET);
+    fprintf(fp, "},\n \"counters\":{\"cache_hits\":%ld,\"cache_misses\":%ld,\"disk_hits\":%ld,\"disk_misses\":%ld,"
+                "\"profile_bytes\":%llu,\"journal_bytes\":%llu,\"nodes_allocated\":%ld,"
+                "\"launches\":%ld,\"launched_urls\":%ld,\"launch_failures\":%ld}}\n",
+            cache->hits, cache->misses, cache->disk ? cache->disk->hits : 0, cache->disk ? cache->disk->misses : 0,
+            stats.profile_bytes, stats.journal_bytes, __atomic_load_n(&stats.nodes_allocated, __ATOMIC_RELAXED),
+            launcher.launches, launcher.urls, launcher.failures);
+    return fclose(fp) == 0 ? 0 : -1;
 }
 
-void clearHistory(HistoryList* history) {
-    while (history->head) {
-        HistoryNode* temp = history->head;
-        history->head = history->head->next;
-        free(temp);
+// Tracing
+// With --trace, nested begin/end spans are appended to a buffer owned by
+// the calling thread, so recording takes no lock; a thread's buffer is
+// pushed onto trace_buffers with a compare-and-swap the first time it
+// records. writeTrace() runs once the loader threads have exited and
+// writes Chrome trace-event JSON, which chrome://tracing and Perfetto open.
+TraceBuffer* traceBuffer() {
+    if (trace_local) return trace_local;
+    TraceBuffer* buffer = (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+    if (!buffer) return NULL;
+    buffer->tid = __atomic_add_fetch(&trace_next_tid, 1, __ATOMIC_RELAXED);
+    buffer->thread_name = "thread";
+    buffer->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&trace_buffers, &buffer->next, buffer, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
     }
-    history->head = NULL;
-    history->current = NULL;
-    history->size = 0;
-    saveData(history, NULL); // Update saved data
-    printf(ANSI_COLOR_GREEN "History cleared successfully!\n" ANSI_COLOR_RESET);
+    trace_local = buffer;
+    return buffer;
 }
 
-void searchHistory(HistoryList* history, TabList* tabs, HashTable* cache, BackStack* stack) {
-    char keyword[URL_LEN];
-    printf("%sEnter search keyword: %s", TEXT_COLOR[theme], ANSI_COLOR_RESET);
-    scanf("%s", keyword);
-    
-    clearScreen();
-    showHeader();
-    printf("%sHistory matching '%s':\n", TEXT_COLOR[theme], keyword);
-    printf("----------------\n");
-    HistoryNode* temp = history->head;
-    int found = 0;
-    int index = 1;
-    while (temp) {
-        if (strstr(temp->url, keyword)) {
-            printf("  %d. %s\n", index++, temp->url);
-            found++;
+void traceEvent(const char* name, char phase) {
+    TraceBuffer* buffer = traceBuffer();
+    if (!buffer) return;
+    if (buffer->count == buffer->capacity) {
+        int capacity = buffer->capacity ? buffer->capacity * 2 : TRACE_BUFFER_EVENTS;
+        TraceEvent* events = (TraceEvent*)realloc(buffer->events, capacity * sizeof(TraceEvent));
+        if (!events) {
+            buffer->dropped++;
+            return;
         }
-        temp = temp->next;
+        buffer->events = events;
+        buffer->capacity = capacity;
     }
-    if (!found) {
-        printf("No matches found.\n");
-    } else {
-        printf("----------------\n");
-        printf("Enter number to visit URL (0 to cancel): ");
-        int choice;
-        scanf("%d", &choice);
-        if (choice > 0 && choice < index) {
-            temp = history->head;
-            int i = 1;
-            while (temp && i < choice) {
-                temp = temp->next;
-                i++;
-            }
-            if (temp) {
-                addToHistory(history, temp->url);
-                addTab(tabs, temp->url);
-                pushBackStack(stack, temp->url);
-                fetchContent(cache, temp->url);
+    TraceEvent* event = &buffer->events[buffer->count++];
+    event->name = name;
+    event->phase = phase;
+    event->ticks = statTicks();
+}
+
+void traceThreadName(const char* name) {
+    TraceBuffer* buffer = traceBuffer();
+    if (buffer) buffer->thread_name = name;
+}
+
+// Writes every thread's spans to path and releases the buffers. Returns 0
+// on success.
+int writeTrace(const char* path) {
+    if (!tracing || !path) return 0;
+    tracing = 0;
+    FILE* fp = fopen(path, "w");
+    double us_per_tick = statNsPerTick() / 1000.0;
+    long dropped = 0;
+    int first = 1;
+    if (fp) fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    while (trace_buffers) {
+        TraceBuffer* buffer = trace_buffers;
+        if (fp) {
+            fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",", buffer->tid, buffer->thread_name);
+            first = 0;
+            for (int i = 0; i < buffer->count; i++) {
+                TraceEvent* event = &buffer->events[i];
+                double ts = event->ticks > stats.base_ticks ? (event->ticks - stats.base_ticks) * us_per_tick : 0.0;
+                fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                        event->name, event->phase, ts, buffer->tid);
             }
         }
+        dropped += buffer->dropped;
+        trace_buffers = buffer->next;
+        free(buffer->events);
+        free(buffer);
     }
-    printf("----------------\n%s", ANSI_COLOR_RESET);
-    printf("Press Enter to continue...");
-    getchar();
-    getchar();
+    trace_local = NULL;
+    if (!fp) return -1;
+    fprintf(fp, "\n],\"otherData\":{\"dropped_events\":%ld}}\n", dropped);
+    return fclose(fp) == 0 ? 0 : -1;
 }
 
-// Tab Management
-void initTabs(TabList* tabs) {
-    tabs->current = NULL;
-    tabs->tab_count = 0;
+// Frame Renderer
+// Screen output is composed into per-region buffers and written with a
+// single write() when the program is about to wait for input. A new frame
+// (clearScreen) is compared with the one on screen region by region and
+// only redrawn from the first region that changed, by moving the cursor
+// there and clearing to the end of the screen. If the previous frame had
+// scrolled, or the terminal size is unknown, the whole screen is redrawn.
+// Regions only move forward within a frame, so buffer order is screen order.
+void uiInit() {
+    ui.enabled = 1;
+    ui.region = REGION_HEADER;
+    ui.input_region = REGION_COUNT;
+    #ifdef _WIN32
+        HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode = 0;
+        if (GetConsoleMode(out, &mode)) {
+            SetConsoleMode(out, mode | 0x0004); // ENABLE_VIRTUAL_TERMINAL_PROCESSING
+        }
+    #endif
 }
 
-void addTab(TabList* tabs, const char* url) {
-    if (tabs->tab_count >= MAX_TABS) {
-        printf(ANSI_COLOR_RED "Maximum tabs reached!\n" ANSI_COLOR_RESET);
-        return;
+int uiAppend(UiBuffer* buffer, const char* data, size_t length) {
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 1024;
+        while (buffer->length + length + 1 > capacity) capacity *= 2;
+        char* grown = (char*)realloc(buffer->data, capacity);
+        if (!grown) return 0;
+        buffer->data = grown;
+        buffer->capacity = capacity;
     }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+    return 1;
+}
 
-    TabNode* newTab = (TabNode*)malloc(sizeof(TabNode));
-    if (!newTab) {
-        printf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
+void uiPrintf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (!ui.enabled) {
+        vprintf(format, args);
+        va_end(args);
         return;
     }
-    strncpy(newTab->url, url, URL_LEN - 1);
-    newTab->url[URL_LEN - 1] = '\0';
-
-    if (tabs->current == NULL) {
-        newTab->next = newTab;
-        newTab->prev = newTab;
-        tabs->current = newTab;
-    } else {
-        newTab->next = tabs->current->next;
-        newTab->prev = tabs->current;
-        tabs->current->next->prev = newTab;
-        tabs->current->next = newTab;
-        tabs->current = newTab;
+    char text[1024];
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(text, sizeof(text), format, copy);
+    va_end(copy);
+    if (length >= (int)sizeof(text)) {
+        char* big = (char*)malloc(length + 1);
+        if (big) {
+            vsnprintf(big, length + 1, format, args);
+            uiAppend(&ui.regions[ui.region], big, length);
+            free(big);
+        }
+    } else if (length > 0) {
+        uiAppend(&ui.regions[ui.region], text, length);
     }
-    tabs->tab_count++;
+    va_end(args);
 }
 
-void switchTab(TabList* tabs, int index) {
-    if (index < 1 || index > tabs->tab_count) {
-        printf(ANSI_COLOR_RED "Invalid tab index!\n" ANSI_COLOR_RESET);
-        return;
-    }
-    TabNode* temp = tabs->current;
-    for (int i = 1; i < index; i++) {
-        temp = temp->next;
-    }
-    tabs->current = temp;
+void uiRegion(int region) {
+    if (region > ui.region) ui.region = region;
 }
 
-void showTabs(TabList* tabs) {
-    printf("%s", TEXT_COLOR[theme]);
-    printf("Open Tabs:\n");
-    printf("----------------\n");
-    if (tabs->tab_count == 0) {
-        printf("No tabs open!\n");
-    } else {
-        TabNode* temp = tabs->current;
-        int i = 1;
-        do {
-            printf("%s%d. %s\n", (temp == tabs->current) ? "> " : "  ", i++, temp->url);
-            temp = temp->next;
-        } while (temp != tabs->current);
-    }
-    printf("----------------\n\n");
-    printf("%s", ANSI_COLOR_RESET);
+int terminalSize(int* rows, int* cols) {
+    #ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) return 0;
+        *rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+        *cols = info.srWindow.Right - info.srWindow.Left + 1;
+    #else
+        struct winsize size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_row == 0) return 0;
+        *rows = size.ws_row;
+        *cols = size.ws_col;
+    #endif
+    return 1;
 }
 
-// Hash Table for URL Caching
-void initHashTable(HashTable* cache) {
-    for (int i = 0; i < HASH_SIZE; i++) {
-        cache->table[i] = NULL;
+// Advances a 0-based cursor position over text as the terminal would,
+// skipping escape sequences and wrapping at cols.
+void uiAdvance(const char* text, size_t length, int cols, int* row, int* col) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '\x1b') {
+            if (i + 1 < length && text[i + 1] == '[') {
+                i += 2;
+                while (i < length && !(text[i] >= '@' && text[i] <= '~')) i++;
+            }
+        } else if (c == '\n') {
+            (*row)++;
+            *col = 0;
+        } else if (c == '\r') {
+            *col = 0;
+        } else if (c >= ' ' && (c & 0xC0) != 0x80) {
+            if (*col >= cols) {
+                (*row)++;
+                *col = 0;
+            }
+            (*col)++;
+        }
     }
 }
 
-unsigned int hash(const char* url) {
-    unsigned int hash = 0;
-    while (*url) {
-        hash = (hash * 31 + *url) % HASH_SIZE;
-        url++;
+void uiWrite(const char* data, size_t length) {
+    fflush(stdout);
+    while (length > 0) {
+        long written = (long)write(STDOUT_FILENO, data, (unsigned)length);
+        if (written <= 0) break;
+        data += written;
+        length -= (size_t)written;
     }
-    return hash;
 }
 
-void addToCache(HashTable* cache, const char* url, const char* content) {
-    unsigned int index = hash(url);
-    CacheNode* newNode = (CacheNode*)malloc(sizeof(CacheNode));
-    if (!newNode) {
-        printf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
+// Puts everything composed so far on screen.
+void uiFlush() {
+    if (!ui.enabled) {
+        fflush(stdout);
         return;
     }
-    strncpy(newNode->url, url, URL_LEN - 1);
-    newNode->url[URL_LEN - 1] = '\0';
-    strncpy(newNode->content, content, CONTENT_LEN - 1);
-    newNode->content[CONTENT_LEN - 1] = '\0';
-    newNode->next = cache->table[index];
-    cache->table[index] = newNode;
-}
+    UiBuffer* out = &ui.output;
+    out->length = 0;
+    int rows = 0, cols = 0;
+    int sized = terminalSize(&rows, &cols);
+    if (!sized) cols = 80;
 
-char* getFromCache(HashTable* cache, const char* url) {
-    unsigned int index = hash(url);
-    CacheNode* temp = cache->table[index];
-    while (temp) {
-        if (strcmp(temp->url, url) == 0) {
-            return temp->content;
+    int start;
+    if (ui.fresh) {
+        int changed = 0;
+        while (changed < REGION_COUNT && ui.regions[changed].length == ui.shown[changed].length &&
+               memcmp(ui.regions[changed].data, ui.shown[changed].data, ui.shown[changed].length) == 0) {
+            changed++;
+        }
+        if (changed > ui.input_region) changed = ui.input_region;
+        if (!sized || ui.frames == 0 || ui.shown_rows >= rows) {
+            uiAppend(out, "\x1b[H\x1b[2J", 7);
+            changed = 0;
+            ui.full_redraws++;
+        } else {
+            int row = 0, col = 0;
+            for (int i = 0; i < changed; i++) {
+                uiAdvance(ui.shown[i].data, ui.shown[i].length, cols, &row, &col);
+            }
+            char move[32];
+            int length = snprintf(move, sizeof(move), "\x1b[%d;%dH\x1b[J", row + 1, col + 1);
+            uiAppend(out, move, length);
+        }
+        start = changed;
+        ui.frames++;
+        ui.fresh = 0;
+        ui.input_region = REGION_COUNT;
+        for (int i = start; i < REGION_COUNT; i++) {
+            uiAppend(out, ui.regions[i].data, ui.regions[i].length);
+        }
+    } else {
+        start = ui.flushed_region;
+        uiAppend(out, ui.regions[start].data + ui.flushed_length, ui.regions[start].length - ui.flushed_length);
+        for (int i = start + 1; i < REGION_COUNT; i++) {
+            uiAppend(out, ui.regions[i].data, ui.regions[i].length);
         }
-        temp = temp->next;
     }
-    return NULL;
-}
+    if (out->length > 0) {
+        TRACE_BEGIN("terminal write");
+        uiWrite(out->data, out->length);
+        TRACE_END("terminal write");
+    }
 
-// Backtracking Stack
-void initBackStack(BackStack* stack) {
-    stack->top = NULL;
+    ui.flushed_region = ui.region;
+    ui.flushed_length = ui.regions[ui.region].length;
+    int row = 0, col = 0;
+    for (int i = 0; i < REGION_COUNT; i++) {
+        uiAdvance(ui.regions[i].data, ui.regions[i].length, cols, &row, &col);
+    }
+    ui.shown_rows = row + ui.inputs;
 }
 
-void pushBackStack(BackStack* stack, const char* url) {
-    StackNode* newNode = (StackNode*)malloc(sizeof(StackNode));
-    if (!newNode) {
-        printf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
+// Flushes before a blocking read; the echoed input line moves everything
+// after it down, so later regions can no longer be positioned from the top.
+void uiInput() {
+    if (!ui.enabled) {
+        fflush(stdout);
         return;
     }
-    strncpy(newNode->url, url, URL_LEN - 1);
-    newNode->url[URL_LEN - 1] = '\0';
-    newNode->next = stack->top;
-    stack->top = newNode;
+    uiFlush();
+    if (ui.region < ui.input_region) ui.input_region = ui.region;
+    ui.inputs++;
+    ui.shown_rows++;
 }
 
-char* popBackStack(BackStack* stack) {
-    if (!stack->top) return NULL;
-    StackNode* temp = stack->top;
-    char* url = (char*)malloc(URL_LEN * sizeof(char));
-    if (!url) {
-        printf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
-        return NULL;
+// Starts a new frame. Output that never reached the screen is dropped.
+void clearScreen() {
+    if (!ui.enabled) {
+        printf("\x1b[H\x1b[2J");
+        return;
     }
-    strncpy(url, temp->url, URL_LEN - 1);
-    url[URL_LEN - 1] = '\0';
-    stack->top = temp->next;
-    free(temp);
-    return url;
-}
-
-// Bookmark Management
-BookmarkNode* initBookmarks() {
-    return NULL;
-}
-
-BookmarkNode* insertBookmark(BookmarkNode* root, const char* url) {
-    if (!root) {
-        BookmarkNode* newNode = (BookmarkNode*)malloc(sizeof(BookmarkNode));
-        if (!newNode) {
-            printf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
-            return NULL;
+    if (ui.fresh && ui.region == REGION_HEADER && ui.regions[REGION_HEADER].length == 0) return;
+    if (!ui.fresh) {
+        ui.regions[ui.flushed_region].length = ui.flushed_length;
+        for (int i = ui.flushed_region + 1; i < REGION_COUNT; i++) ui.regions[i].length = 0;
+    }
+    // When the last frame never reached the screen, the one before it is
+    // still what is shown.
+    if (!ui.fresh) {
+        for (int i = 0; i < REGION_COUNT; i++) {
+            UiBuffer shown = ui.shown[i];
+            ui.shown[i] = ui.regions[i];
+            ui.regions[i] = shown;
         }
-        strncpy(newNode->url, url, URL_LEN - 1);
-        newNode->url[URL_LEN - 1] = '\0';
-        newNode->left = newNode->right = NULL;
-        return newNode;
     }
-    if (strcmp(url, root->url) < 0)
-        root->left = insertBookmark(root->left, url);
-    else if (strcmp(url, root->url) > 0)
-        root->right = insertBookmark(root->right, url);
-    return root;
+    for (int i = 0; i < REGION_COUNT; i++) ui.regions[i].length = 0;
+    ui.region = REGION_HEADER;
+    ui.fresh = 1;
+    ui.inputs = 0;
 }
 
-int bookmarkExists(BookmarkNode* root, const char* url) {
-    if (!root) return 0;
-    if (strcmp(url, root->url) == 0) return 1;
-    return bookmarkExists(root->left, url) || bookmarkExists(root->right, url);
+void showHeader() {
+    clearScreen();
+    uiRegion(REGION_HEADER);
+    uiPrintf("%s", HEADER_COLOR[theme]);
+    uiPrintf("=============================================\n");
+    uiPrintf("|      Pranav's Surf Browser v4.1           |\n");
+    uiPrintf("|  Powered by Advanced C Data Structures    |\n");
+    uiPrintf("=============================================\n");
+    uiPrintf("%s", ANSI_COLOR_RESET);
+    uiPrintf("\n");
 }
 
-void addBookmark(BookmarkNode** root, TabList* tabs) {
-    if (!tabs->current) {
-        printf(ANSI_COLOR_RED "No active tab to bookmark!\n" ANSI_COLOR_RESET);
-        return;
+void showFakeFeatures(HashTable* cache) {
+    uiPrintf("%s", TEXT_COLOR[theme]);
+    uiPrintf("--- Advanced Features ---\n");
+    uiPrintf("  * SSL Encryption: Secure Browsing Enabled\n");
+    uiPrintf("  * CloudSync Serverless Backend: Active\n");
+    uiPrintf("  * Firewall Protection: Intrusion Blocked\n");
+    uiPrintf("  * AI-Powered Threat Detection: Running\n");
+    uiPrintf("  * Profile Load: %ld entries, %ld bookmarks in %.2f ms\n",
+           load_stats.history_records, load_stats.bookmark_records, load_stats.millis);
+    uiPrintf("  * Page Cache: %d pages, %zu/%zu KB, %ld hits, %ld misses, %ld evictions\n",
+           cache->entries, cache->bytes / 1024, cache->byte_budget / 1024,
+           cache->hits, cache->misses, cache->evictions);
+    if (cache->page_bytes > 0) {
+        uiPrintf("  * Compression: pages stored in %.0f%% of %llu KB, mean decode %.2f us\n",
+                 100.0 * cache->stored_bytes / cache->page_bytes, cache->page_bytes / 1024,
+                 cache->decodes ? cache->decode_ms * 1000.0 / cache->decodes : 0.0);
     }
-    if (bookmarkExists(*root, tabs->current->url)) {
-        printf(ANSI_COLOR_RED "URL already bookmarked!\n" ANSI_COLOR_RESET);
-    } else {
-        *root = insertBookmark(*root, tabs->current->url);
-        saveData(NULL, *root); // Save bookmarks
-        printf(ANSI_COLOR_GREEN "Bookmark added: %s\n" ANSI_COLOR_RESET, tabs->current->url);
+    if (cache->prefetches > 0) {
+        uiPrintf("  * Prefetch: %ld pages warmed, %ld used (%.0f%%), %ld wasted (%zu KB)\n",
+                 cache->prefetches, cache->prefetch_hits, 100.0 * cache->prefetch_hits / cache->prefetches,
+                 cache->prefetch_wasted, cache->prefetch_wasted_bytes / 1024);
     }
-    printf("Press Enter to continue...");
-    getchar();
-    getchar();
+    if (cache->disk) {
+        uiPrintf("  * Disk Cache: %u pages, %llu/%llu KB, %ld hits, %ld misses, %ld written\n",
+                 cache->disk->count, (unsigned long long)(cache->disk->live_bytes / 1024),
+                 (unsigned long long)(cache->disk->capacity / 1024),
+                 cache->disk->hits, cache->disk->misses, cache->disk->spills);
+    }
+    if (loader.submitted > 0) {
+        long steals = 0;
+        for (int i = 0; i < loader.count; i++) steals += loader.workers[i].steals;
+        uiPrintf("  * Loader: %d workers, %ld of %ld pages loaded, %ld stolen\n",
+                 loader.count, __atomic_load_n(&loader.completed, __ATOMIC_ACQUIRE), loader.submitted, steals);
+    }
+    if (http.requests > 0) {
+        uiPrintf("  * HTTP: %ld requests, %ld connections (%ld reused), %llu KB received\n",
+                 http.requests, http.connects, http.reuses, http.bytes / 1024);
+    }
+    uiPrintf("-------------------------\n\n");
+    uiPrintf("%s", ANSI_COLOR_RESET);
 }
 
-void viewBookmarks(BookmarkNode* root, HistoryList* history, TabList* tabs, HashTable* cache, BackStack* stack) {
-    clearScreen();
-    showHeader();
-    printf("%sBookmarked URLs:\n", TEXT_COLOR[theme]);
-    printf("----------------\n");
-    
-    if (!root) {
-        printf("No bookmarks yet!\n");
+// Node Pools
+// Slab allocator for fixed-size nodes: nodes are carved out of
+// POOL_SLAB_NODES-sized slabs by bumping a pointer, freed nodes go on a
+// free list for reuse, and a whole pool is released one slab at a time.
+void initPool(NodePool* pool, size_t node_size) {
+    pool->node_size = node_size < sizeof(void*) ? sizeof(void*) : node_size;
+    pool->slabs = NULL;
+    pool->bump = NULL;
+    pool->bump_end = NULL;
+    pool->free_list = NULL;
+    pool->allocs = 0;
+    pool->frees = 0;
+    pool->live = 0;
+    pool->slab_count = 0;
+}
+
+void* poolAlloc(NodePool* pool) {
+    void* node;
+    if (pool->free_list) {
+        node = pool->free_list;
+        pool->free_list = *(void**)node;
     } else {
-        BookmarkNode* bookmarks[100];
-        int count = 0;
-        void collectBookmarks(BookmarkNode* node) {
-            if (node) {
-                collectBookmarks(node->left);
-                bookmarks[count++] = node;
-                collectBookmarks(node->right);
-            }
-        }
-        collectBookmarks(root);
-        
-        for (int i = 0; i < count; i++) {
-            printf("  %d. %s\n", i + 1, bookmarks[i]->url);
-        }
-        printf("----------------\n");
-        printf("Enter number to visit bookmark (0 to cancel): ");
-        int choice;
-        scanf("%d", &choice);
-        if (choice > 0 && choice <= count) {
-            addToHistory(history, bookmarks[choice - 1]->url);
-            addTab(tabs, bookmarks[choice - 1]->url);
-            pushBackStack(stack, bookmarks[choice - 1]->url);
-            fetchContent(cache, bookmarks[choice - 1]->url);
+        if (pool->bump == pool->bump_end) {
+            PoolSlab* slab = (PoolSlab*)malloc(sizeof(PoolSlab) + POOL_SLAB_NODES * pool->node_size);
+            if (!slab) return NULL;
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->slab_count++;
+            pool->bump = (char*)(slab + 1);
+            pool->bump_end = pool->bump + POOL_SLAB_NODES * pool->node_size;
         }
+        node = pool->bump;
+        pool->bump += pool->node_size;
     }
-    printf("----------------\n%s", ANSI_COLOR_RESET);
-    printf("Press Enter to continue...");
-    getchar();
-    getchar();
+    pool->allocs++;
+    pool->live++;
+    STAT_ADD(nodes_allocated, 1);
+    return node;
 }
 
-void freeBookmarks(BookmarkNode* root) {
-    if (root) {
-        freeBookmarks(root->left);
-        freeBookmarks(root->right);
-        free(root);
+void poolFree(NodePool* pool, void* node) {
+    if (!node) return;
+    *(void**)node = pool->free_list;
+    pool->free_list = node;
+    pool->frees++;
+    pool->live--;
+}
+
+// Frees every node of the pool at once.
+void poolReleaseAll(NodePool* pool) {
+    while (pool->slabs) {
+        PoolSlab* next = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next;
     }
+    pool->frees += pool->live;
+    pool->live = 0;
+    pool->slab_count = 0;
+    pool->bump = pool->bump_end = NULL;
+    pool->free_list = NULL;
 }
 
-// File-Based Database
-void saveData(HistoryList* history, BookmarkNode* root) {
-    FILE* fp = fopen("browser_data.txt", "w");
-    if (!fp) {
-        printf(ANSI_COLOR_RED "Failed to save data!\n" ANSI_COLOR_RESET);
-        return;
+// 64-bit FNV-1a with a murmur3 finalizer so the low bits used for the
+// slot index depend on every byte of the URL.
+unsigned long long hashURL(const char* url) {
+    unsigned long long h = 14695981039346656037ULL;
+    while (*url) {
+        h ^= (unsigned char)*url++;
+        h *= 1099511628211ULL;
     }
-    HistoryNode* h = history ? history->head : NULL;
-    while (h) {
-        fprintf(fp, "H:%s\n", h->url);
-        h = h->next;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// URL Intern Table
+// Every distinct URL is stored once, in variable-length arena blocks, and
+// is referred to everywhere else by a dense UrlId. Ids index a two-level
+// directory that is never reallocated, so an id and its text stay valid
+// for the whole session.
+InternedURL* urlEntry(UrlId id) {
+    return &url_table.chunks[id / INTERN_CHUNK_IDS][id % INTERN_CHUNK_IDS];
+}
+
+const char* urlText(UrlId id) {
+    return id == NO_URL ? "" : urlEntry(id)->text;
+}
+
+unsigned long long urlHash(UrlId id) {
+    return urlEntry(id)->hash;
+}
+
+// Returns the id of url, or NO_URL if it was never interned.
+UrlId findURL(const char* url) {
+    if (url_table.count == 0) return NO_URL;
+    unsigned long long h = hashURL(url);
+    unsigned int mask = url_table.capacity - 1;
+    for (unsigned int i = (unsigned int)h & mask; url_table.slots[i] != NO_URL; i = (i + 1) & mask) {
+        InternedURL* entry = urlEntry(url_table.slots[i]);
+        if (entry->hash == h && strcmp(entry->text, url) == 0) return url_table.slots[i];
     }
-    void saveBookmarks(BookmarkNode* node) {
-        if (node) {
-            fprintf(fp, "B:%s\n", node->url);
-            saveBookmarks(node->left);
-            saveBookmarks(node->right);
-        }
+    return NO_URL;
+}
+
+char* internArenaAlloc(size_t size) {
+    if (size > url_table.arena_left) {
+        size_t block = size > INTERN_ARENA_BYTES ? size : INTERN_ARENA_BYTES;
+        ArenaBlock* arena = (ArenaBlock*)malloc(sizeof(ArenaBlock) + block);
+        if (!arena) return NULL;
+        arena->next = url_table.arenas;
+        url_table.arenas = arena;
+        url_table.arena_next = arena->data;
+        url_table.arena_left = block;
     }
-    if (root) saveBookmarks(root);
-    fclose(fp);
+    char* text = url_table.arena_next;
+    url_table.arena_next += size;
+    url_table.arena_left -= size;
+    return text;
 }
 
-void loadData(HistoryList* history, BookmarkNode** root) {
-    FILE* fp = fopen("browser_data.txt", "r");
-    if (!fp) return;
-    char line[URL_LEN + 2];
-    while (fgets(line, sizeof(line), fp)) {
-        line[strcspn(line, "\n")] = 0;
-        if (line[0] == 'H') {
-            addToHistory(history, line + 2);
-        } else if (line[0] == 'B') {
-            *root = insertBookmark(*root, line + 2);
+// Registers a string that lives for the rest of the session (arena or a
+// mapped profile) under the next id.
+UrlId addInternedURL(const char* text, unsigned int length, unsigned long long h) {
+    UrlId id = url_table.count + 1;
+    if (id / INTERN_CHUNK_IDS >= INTERN_MAX_CHUNKS) return NO_URL;
+    if ((url_table.count + 1) * 2 > url_table.capacity) {
+        unsigned int capacity = url_table.capacity ? url_table.capacity * 2 : 1024;
+        UrlId* slots = (UrlId*)calloc(capacity, sizeof(UrlId));
+        if (!slots) return NO_URL;
+        for (unsigned int i = 0; i < url_table.capacity; i++) {
+            if (url_table.slots[i] == NO_URL) continue;
+            unsigned int j = (unsigned int)urlHash(url_table.slots[i]) & (capacity - 1);
+            while (slots[j] != NO_URL) j = (j + 1) & (capacity - 1);
+            slots[j] = url_table.slots[i];
+        }
+        free(url_table.slots);
+        url_table.slots = slots;
+        url_table.capacity = capacity;
+    }
+    InternedURL** chunk = &url_table.chunks[id / INTERN_CHUNK_IDS];
+    if (!*chunk && !(*chunk = (InternedURL*)calloc(INTERN_CHUNK_IDS, sizeof(InternedURL)))) return NO_URL;
+    InternedURL* entry = &(*chunk)[id % INTERN_CHUNK_IDS];
+    entry->text = text;
+    entry->length = length;
+    entry->awake_tabs = 0;
+    entry->hash = h;
+    unsigned int i = (unsigned int)h & (url_table.capacity - 1);
+    while (url_table.slots[i] != NO_URL) i = (i + 1) & (url_table.capacity - 1);
+    url_table.slots[i] = id;
+    url_table.count = id;
+    url_table.bytes += length + 1;
+    return id;
+}
+
+UrlId internURL(const char* url) {
+    UrlId id = findURL(url);
+    if (id != NO_URL) return id;
+    size_t length = strlen(url);
+    char* text = internArenaAlloc(length + 1);
+    if (!text) return NO_URL;
+    memcpy(text, url, length + 1);
+    return addInternedURL(text, (unsigned int)length, hashURL(url));
+}
+
+void freeURLs() {
+    while (url_table.arenas) {
+        ArenaBlock* next = url_table.arenas->next;
+        free(url_table.arenas);
+        url_table.arenas = next;
+    }
+    for (int i = 0; i < INTERN_MAX_CHUNKS && url_table.chunks[i]; i++) {
+        free(url_table.chunks[i]);
+        url_table.chunks[i] = NULL;
+    }
+    free(url_table.slots);
+    url_table.slots = NULL;
+    url_table.capacity = 0;
+    url_table.count = 0;
+    url_table.bytes = 0;
+    url_table.arena_next = NULL;
+    url_table.arena_left = 0;
+}
+
+// History Management
+// One entry per distinct URL with its visit count and the time of its last
+// visit, found by UrlId through by_url. Entries are kept in a skip list
+// ordered by last visit (then by stamp), so the entries of a time range
+// are found in O(log n) and a whole range is unlinked in O(log n + k).
+// Its bottom level runs from the least to the most recently visited entry.
+// Single visits are kept only in the recent ring, which feeds the
+// navigation model; pruneHistory() applies the retention limits.
+void initHistory(HistoryList* history) {
+    history->oldest = NULL;
+    history->newest = NULL;
+    history->by_url = NULL;
+    history->url_capacity = 0;
+    history->size = 0;
+    history->visits = 0;
+    history->next_seq = 0;
+    history->pruned = 0;
+    history->deleted = 0;
+    memset(history->skip_head, 0, sizeof(history->skip_head));
+    history->levels = 1;
+    history->stamp = 0;
+    history->seed = 2463534242u;
+    history->dead = NULL;
+    history->dead_count = 0;
+    history->recent_first = 0;
+    history->recent_count = 0;
+    initSuggestIndex(&history->suggest);
+    initTrigramIndex(&history->search);
+    initTransitionModel(&history->transitions);
+    initPool(&history->nodes, sizeof(HistoryEntry));
+}
+
+HistoryEntry* findHistoryEntry(HistoryList* history, UrlId url) {
+    return url < history->url_capacity ? history->by_url[url] : NULL;
+}
+
+// Returns the link to the entry after entry at level; entry NULL is the
+// head of the list.
+HistoryEntry** timeLink(HistoryList* history, HistoryEntry* entry, int level) {
+    if (!entry) return level == 0 ? &history->oldest : &history->skip_head[level - 1];
+    return level == 0 ? &entry->next : &entry->up[level - 1];
+}
+
+// Fills update with the last entry ordered before (time, stamp) at every
+// level, NULL where that is the head.
+void findTimePredecessors(HistoryList* history, long long time, unsigned long long stamp, HistoryEntry** update) {
+    HistoryEntry* x = NULL;
+    for (int level = history->levels - 1; level >= 0; level--) {
+        HistoryEntry* next;
+        while ((next = *timeLink(history, x, level)) &&
+               (next->last_visit < time || (next->last_visit == time && next->stamp < stamp))) {
+            x = next;
+        }
+        update[level] = x;
+    }
+}
+
+// Links entry by its last_visit and stamp. Its level and up are set.
+void linkHistoryEntry(HistoryList* history, HistoryEntry* entry) {
+    HistoryEntry* update[HISTORY_SKIP_LEVELS];
+    findTimePredecessors(history, entry->last_visit, entry->stamp, update);
+    while (history->levels < entry->level) update[history->levels++] = NULL;
+    for (int level = 0; level < entry->level; level++) {
+        HistoryEntry** link = timeLink(history, update[level], level);
+        *timeLink(history, entry, level) = *link;
+        *link = entry;
+    }
+    entry->prev = update[0];
+    if (entry->next) entry->next->prev = entry;
+    else history->newest = entry;
+}
+
+void unlinkHistoryEntry(HistoryList* history, HistoryEntry* entry) {
+    HistoryEntry* update[HISTORY_SKIP_LEVELS];
+    findTimePredecessors(history, entry->last_visit, entry->stamp, update);
+    for (int level = 0; level < entry->level; level++) {
+        *timeLink(history, update[level], level) = *timeLink(history, entry, level);
+    }
+    if (entry->next) entry->next->prev = entry->prev;
+    else history->newest = entry->prev;
+}
+
+// Adds visits to the entry for url, creating it if needed, and makes it
+// the most recently visited. Returns NULL if memory ran out.
+HistoryEntry* touchHistoryEntry(HistoryList* history, UrlId url, unsigned int visits, long long when) {
+    HistoryEntry* entry = findHistoryEntry(history, url);
+    if (entry) {
+        unlinkHistoryEntry(history, entry);
+    } else {
+        if (url >= history->url_capacity) {
+            unsigned int capacity = history->url_capacity ? history->url_capacity : 1024;
+            while (capacity <= url) capacity *= 2;
+            HistoryEntry** by_url = (HistoryEntry**)realloc(history->by_url, capacity * sizeof(HistoryEntry*));
+            if (!by_url) return NULL;
+            memset(by_url + history->url_capacity, 0, (capacity - history->url_capacity) * sizeof(HistoryEntry*));
+            history->by_url = by_url;
+            history->url_capacity = capacity;
+        }
+        entry = (HistoryEntry*)poolAlloc(&history->nodes);
+        if (!entry) return NULL;
+        // Each level above the first holds a quarter of the entries below.
+        unsigned int bits = history->seed;
+        bits ^= bits << 13;
+        bits ^= bits >> 17;
+        bits ^= bits << 5;
+        history->seed = bits;
+        entry->level = 1;
+        while (entry->level < HISTORY_SKIP_LEVELS && (bits & 3) == 0) {
+            entry->level++;
+            bits >>= 2;
+        }
+        entry->up = NULL;
+        if (entry->level > 1) {
+            entry->up = (HistoryEntry**)malloc((entry->level - 1) * sizeof(HistoryEntry*));
+            if (!entry->up) entry->level = 1;
+        }
+        entry->url = url;
+        entry->visits = 0;
+        entry->last_visit = when;
+        entry->seq = history->next_seq++;
+        history->by_url[url] = entry;
+        history->size++;
+        indexHistoryEntry(&history->search, entry);
+    }
+    entry->visits += visits;
+    if (when > entry->last_visit) entry->last_visit = when;
+    entry->stamp = ++history->stamp;
+    history->visits += visits;
+    linkHistoryEntry(history, entry);
+    recordVisit(&history->suggest, url, visits);
+    return entry;
+}
+
+// Appends a visit to the recent ring and teaches the navigation model the
+// step from the visit before it.
+void pushRecentVisit(HistoryList* history, UrlId url, long long when) {
+    if (history->recent_count > 0) {
+        int last = (history->recent_first + history->recent_count - 1) % HISTORY_RECENT_VISITS;
+        recordTransition(&history->transitions, history->recent[last].url, url);
+    }
+    if (history->recent_count == HISTORY_RECENT_VISITS) {
+        history->recent_first = (history->recent_first + 1) % HISTORY_RECENT_VISITS;
+        history->recent_count--;
+    }
+    VisitEvent* event = &history->recent[(history->recent_first + history->recent_count++) % HISTORY_RECENT_VISITS];
+    event->url = url;
+    event->time = when;
+}
+
+// Records a visit made at when without journaling it; used by the loader.
+void appendHistory(HistoryList* history, UrlId url, long long when) {
+    if (!touchHistoryEntry(history, url, 1, when)) {
+        uiPrintf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
+        return;
+    }
+    pushRecentVisit(history, url, when);
+}
+
+void addToHistory(HistoryList* history, const char* url) {
+    unsigned long long start = STAT_START();
+    TRACE_BEGIN("addToHistory");
+    long long now = (long long)time(NULL);
+    appendHistory(history, internURL(url), now);
+    journalVisit(url, now);
+    STAT_STOP(STAT_HISTORY_ADD, start);
+    TRACE_END("addToHistory");
+}
+
+// Rebuilds the suggestion and search indexes from the entries left after
+// pruning or deletion, renumbering them in visit order, and releases the
+// deleted entries. The navigation model is relearned from the recent ring.
+void rebuildHistoryIndexes(HistoryList* history) {
+    freeSuggestIndex(&history->suggest);
+    freeTrigramIndex(&history->search);
+    freeTransitionModel(&history->transitions);
+    while (history->dead) {
+        HistoryEntry* next = history->dead->next;
+        poolFree(&history->nodes, history->dead);
+        history->dead = next;
+    }
+    history->dead_count = 0;
+    history->next_seq = 0;
+    for (HistoryEntry* entry = history->oldest; entry; entry = entry->next) {
+        entry->seq = history->next_seq++;
+        recordVisit(&history->suggest, entry->url, entry->visits);
+        indexHistoryEntry(&history->search, entry);
+    }
+    for (int i = 1; i < history->recent_count; i++) {
+        recordTransition(&history->transitions,
+                         history->recent[(history->recent_first + i - 1) % HISTORY_RECENT_VISITS].url,
+                         history->recent[(history->recent_first + i) % HISTORY_RECENT_VISITS].url);
+    }
+}
+
+// Drops the least recently visited entries beyond history_limit and those
+// not visited for history_max_age seconds (0 turns either limit off). It
+// only starts once a limit is exceeded by an eighth, so the profile is
+// rewritten once per many visits. Returns the number of entries dropped.
+int pruneHistory(HistoryList* history, long long now) {
+    long long cutoff = now - history_max_age;
+    int over = history_limit > 0 && history->size > history_limit + history_limit / 8;
+    int stale = history_max_age > 0 && history->oldest &&
+                history->oldest->last_visit < cutoff - history_max_age / 8;
+    if (!over && !stale) return 0;
+    int dropped = 0;
+    while (history->oldest && ((history_limit > 0 && history->size > history_limit) ||
+                               (history_max_age > 0 && history->oldest->last_visit < cutoff))) {
+        HistoryEntry* entry = history->oldest;
+        unlinkHistoryEntry(history, entry);
+        history->by_url[entry->url] = NULL;
+        history->size--;
+        history->visits -= entry->visits;
+        free(entry->up);
+        poolFree(&history->nodes, entry);
+        dropped++;
+    }
+    history->pruned += dropped;
+    rebuildHistoryIndexes(history);
+    return dropped;
+}
+
+// Fills out with up to max entries last visited from time from to time to
+// (inclusive), least recent first. Returns the number of entries in the
+// range, which may be larger than max.
+int findHistoryRange(HistoryList* history, long long from, long long to, HistoryEntry** out, int max) {
+    HistoryEntry* update[HISTORY_SKIP_LEVELS];
+    findTimePredecessors(history, from, 0, update);
+    int count = 0;
+    for (HistoryEntry* entry = *timeLink(history, update[0], 0); entry && entry->last_visit <= to; entry = entry->next) {
+        if (count < max) out[count] = entry;
+        count++;
+    }
+    return count;
+}
+
+// Removes the entries last visited from time from to time to (inclusive)
+// and the recent visits made then. The range is cut out of every level of
+// the skip list at once; the deleted entries are only marked for the
+// suggestion and search indexes, which are rebuilt once an eighth of
+// their entries are deleted. Returns the number of entries removed.
+int deleteHistoryRange(HistoryList* history, long long from, long long to) {
+    if (to == LLONG_MAX) to--;
+    if (from > to) return 0;
+    HistoryEntry* before[HISTORY_SKIP_LEVELS];
+    HistoryEntry* last[HISTORY_SKIP_LEVELS];
+    findTimePredecessors(history, from, 0, before);
+    findTimePredecessors(history, to + 1, 0, last);
+    HistoryEntry* entry = *timeLink(history, before[0], 0);
+    HistoryEntry* end = *timeLink(history, last[0], 0);
+    if (entry == end) return 0;
+    for (int level = 0; level < history->levels; level++) {
+        *timeLink(history, before[level], level) = *timeLink(history, last[level], level);
+    }
+    if (end) end->prev = before[0];
+    else history->newest = before[0];
+
+    int removed = 0;
+    while (entry != end) {
+        HistoryEntry* next = entry->next;
+        history->by_url[entry->url] = NULL;
+        history->size--;
+        history->visits -= entry->visits;
+        forgetVisits(&history->suggest, entry->url);
+        entry->visits = 0;
+        free(entry->up);
+        entry->up = NULL;
+        entry->next = history->dead;
+        history->dead = entry;
+        history->dead_count++;
+        removed++;
+        entry = next;
+    }
+    history->deleted += removed;
+
+    int kept = 0;
+    for (int i = 0; i < history->recent_count; i++) {
+        VisitEvent event = history->recent[(history->recent_first + i) % HISTORY_RECENT_VISITS];
+        if (event.time >= from && event.time <= to) continue;
+        history->recent[(history->recent_first + kept++) % HISTORY_RECENT_VISITS] = event;
+    }
+    history->recent_count = kept;
+    if (history->dead_count > history->size / 8) rebuildHistoryIndexes(history);
+    return removed;
+}
+
+// Shows the HISTORY_VIEW_ENTRIES most recently visited URLs; the rest are
+// reachable through Search History.
+void showHistory(HistoryList* history) {
+    uiRegion(REGION_HISTORY);
+    uiPrintf("%s", TEXT_COLOR[theme]);
+    uiPrintf("Browsing History:\n");
+    uiPrintf("----------------\n");
+    if (history->size == 0) {
+        uiPrintf("No history yet!\n");
+    } else {
+        HistoryEntry* entry = history->newest;
+        int shown = 1;
+        while (shown < HISTORY_VIEW_ENTRIES && entry->prev) {
+            entry = entry->prev;
+            shown++;
+        }
+        int i = history->size - shown + 1;
+        if (i > 1) uiPrintf("  ... %d earlier entr%s\n", i - 1, i == 2 ? "y" : "ies");
+        for (; entry; entry = entry->next) {
+            uiPrintf("%s%d. %s", (entry == history->newest) ? "> " : "  ", i++, urlText(entry->url));
+            if (entry->visits > 1) uiPrintf(" (%u visits)", entry->visits);
+            uiPrintf("\n");
+        }
+    }
+    uiPrintf("----------------\n\n");
+    uiPrintf("%s", ANSI_COLOR_RESET);
+}
+
+void freeHistory(HistoryList* history) {
+    for (HistoryEntry* entry = history->oldest; entry; entry = entry->next) free(entry->up);
+    poolReleaseAll(&history->nodes);
+    free(history->by_url);
+    freeSuggestIndex(&history->suggest);
+    freeTrigramIndex(&history->search);
+    freeTransitionModel(&history->transitions);
+    initHistory(history);
+}
+
+void clearHistory(HistoryList* history) {
+    uiPrintf("%sClear browsing history from:\n", TEXT_COLOR[theme]);
+    uiPrintf("  [1] The last hour\n  [2] The last day\n  [3] The last week\n  [4] All time\n  [0] Cancel\n");
+    uiPrintf("Enter choice: %s", ANSI_COLOR_RESET);
+    int choice = 0;
+    uiInput();
+    if (scanf("%d", &choice) != 1) choice = 0;
+    static const long long spans[] = { 3600, 86400, 7 * 86400 };
+    if (choice >= 1 && choice <= 3) {
+        clearHistoryRange(history, spans[choice - 1]);
+    } else if (choice == 4) {
+        freeHistory(history);
+        journalAppend('C', "");
+        recordAction("clear", NULL);
+        uiPrintf(ANSI_COLOR_GREEN "History cleared successfully!\n" ANSI_COLOR_RESET);
+    }
+}
+
+// Deletes the entries visited in the last seconds seconds, listing them
+// first. Only an "X:from:to" record is journaled.
+void clearHistoryRange(HistoryList* history, long long seconds) {
+    HistoryEntry* shown[HISTORY_VIEW_ENTRIES];
+    long long now = (long long)time(NULL);
+    long long from = now - seconds;
+    int found = findHistoryRange(history, from, LLONG_MAX, shown, HISTORY_VIEW_ENTRIES);
+    for (int i = 0; i < found && i < HISTORY_VIEW_ENTRIES; i++) {
+        char when[32];
+        time_t t = (time_t)shown[i]->last_visit;
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M", localtime(&t));
+        uiPrintf("%s  %s  %s\n", TEXT_COLOR[theme], when, urlText(shown[i]->url));
+    }
+    if (found > HISTORY_VIEW_ENTRIES) uiPrintf("  ... %d more\n", found - HISTORY_VIEW_ENTRIES);
+    int removed = deleteHistoryRange(history, from, LLONG_MAX);
+    char arg[32];
+    snprintf(arg, sizeof(arg), "%lld", seconds);
+    recordAction("clear", arg);
+    journalRecord("X:%lld:%lld\n", from, LLONG_MAX);
+    uiPrintf(ANSI_COLOR_GREEN "Removed %d entr%s from history.\n" ANSI_COLOR_RESET, removed, removed == 1 ? "y" : "ies");
+}
+
+void searchHistory(HistoryList* history, TabList* tabs, HashTable* cache) {
+    char keyword[MAX_URL_LEN];
+    uiPrintf("%sEnter search keyword: %s", TEXT_COLOR[theme], ANSI_COLOR_RESET);
+    uiInput();
+    scanf(URL_INPUT_FORMAT, keyword);
+    
+    showHeader();
+    uiRegion(REGION_BODY);
+    uiPrintf("%sHistory matching '%s':\n", TEXT_COLOR[theme], keyword);
+    uiPrintf("----------------\n");
+    int found = 0;
+    recordAction("search", keyword);
+    HistoryEntry** matches = findInHistory(history, keyword, &found);
+    for (int i = 0; i < found; i++) {
+        uiPrintf("  %d. %s\n", i + 1, urlText(matches[i]->url));
+    }
+    if (!found) {
+        uiPrintf("No matches found.\n");
+    } else {
+        uiPrintf("----------------\n");
+        uiPrintf("Enter number to visit URL (0 to cancel): ");
+        int choice;
+        uiInput();
+        scanf("%d", &choice);
+        if (choice > 0 && choice <= found) {
+            const char* url = urlText(matches[choice - 1]->url);
+            recordAction("visit", url);
+            navigateTo(history, tabs, url, 0);
+            fetchContent(cache, url);
+        }
+    }
+    free(matches);
+    uiPrintf("----------------\n%s", ANSI_COLOR_RESET);
+    uiPrintf("Press Enter to continue...");
+    uiInput();
+    getchar();
+    getchar();
+}
+
+// URL Suggestion Index
+// Radix trie over visited URLs. Every node keeps the best MAX_SUGGESTIONS
+// completions of its subtree, so a lookup only walks the prefix.
+//
+// Frecency is the sum of 2^(visit_clock / FRECENCY_HALF_LIFE) over an
+// entry's visits, kept as a log2 so it never overflows. A visit made
+// FRECENCY_HALF_LIFE visits ago counts half as much as one made now, and
+// since the weight grows with the clock instead of old scores decaying,
+// the scores of entries that are not visited never need updating.
+void initSuggestIndex(SuggestIndex* index) {
+    index->root = NULL;
+    index->clock = 0;
+    index->entries = 0;
+    index->path = NULL;
+    index->path_capacity = 0;
+}
+
+TrieNode* newTrieNode(const char* label, int label_len) {
+    TrieNode* node = (TrieNode*)calloc(1, sizeof(TrieNode));
+    if (!node) return NULL;
+    node->label = (char*)malloc(label_len + 1);
+    if (!node->label) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->label, label, label_len);
+    node->label[label_len] = '\0';
+    node->label_len = label_len;
+    return node;
+}
+
+// Keeps node->top ordered by score after entry's score changed. When a
+// listed entry goes down, an unlisted one may now belong in the list;
+// refillTopSuggestions() covers that case.
+void updateTopSuggestions(TrieNode* node, SuggestEntry* entry) {
+    int i = 0;
+    while (i < node->top_count && node->top[i] != entry) i++;
+    if (i == node->top_count) {
+        if (node->top_count < MAX_SUGGESTIONS) {
+            node->top_count++;
+        } else if (entry->score > node->top[MAX_SUGGESTIONS - 1]->score) {
+            i = MAX_SUGGESTIONS - 1;
+        } else {
+            return;
+        }
+        node->top[i] = entry;
+    }
+    while (i > 0 && node->top[i - 1]->score < entry->score) {
+        node->top[i] = node->top[i - 1];
+        node->top[i - 1] = entry;
+        i--;
+    }
+    while (i + 1 < node->top_count && node->top[i + 1]->score > entry->score) {
+        node->top[i] = node->top[i + 1];
+        node->top[i + 1] = entry;
+        i++;
+    }
+}
+
+// Recomputes node->top from the node's own entry and its children's lists,
+// which must already be up to date.
+void refillTopSuggestions(TrieNode* node) {
+    node->top_count = 0;
+    if (node->entry && node->entry->visits > 0) updateTopSuggestions(node, node->entry);
+    for (TrieNode* child = node->child; child; child = child->sibling) {
+        for (int i = 0; i < child->top_count; i++) updateTopSuggestions(node, child->top[i]);
+    }
+}
+
+// Stores node at index->path[depth], growing the scratch path; URLs have
+// no length limit, so neither has the depth of the trie. Returns 0 when out
+// of memory.
+int pushSuggestPath(SuggestIndex* index, int depth, TrieNode* node) {
+    if (depth == index->path_capacity) {
+        int capacity = index->path_capacity ? index->path_capacity * 2 : 64;
+        TrieNode** path = (TrieNode**)realloc(index->path, capacity * sizeof(TrieNode*));
+        if (!path) return 0;
+        index->path = path;
+        index->path_capacity = capacity;
+    }
+    index->path[depth] = node;
+    return 1;
+}
+
+void recordVisit(SuggestIndex* index, UrlId url, unsigned int visits) {
+    if (!index->root && !(index->root = newTrieNode("", 0))) return;
+
+    int depth = 0;
+    TrieNode* node = index->root;
+    const char* p = urlText(url);
+    if (!pushSuggestPath(index, depth++, node)) return;
+    while (*p) {
+        TrieNode** link = &node->child;
+        while (*link && (*link)->label[0] != *p) link = &(*link)->sibling;
+        TrieNode* child = *link;
+        if (!child) {
+            child = newTrieNode(p, (int)strlen(p));
+            if (!child) return;
+            child->sibling = node->child;
+            node->child = child;
+            node = child;
+            if (!pushSuggestPath(index, depth++, node)) return;
+            break;
+        }
+        int common = 0;
+        while (common < child->label_len && p[common] == child->label[common]) common++;
+        if (common < child->label_len) {
+            // Split the edge so the prefix gets its own node.
+            TrieNode* mid = newTrieNode(child->label, common);
+            if (!mid) return;
+            memmove(child->label, child->label + common, child->label_len - common + 1);
+            child->label_len -= common;
+            mid->sibling = child->sibling;
+            child->sibling = NULL;
+            mid->child = child;
+            memcpy(mid->top, child->top, sizeof(child->top));
+            mid->top_count = child->top_count;
+            *link = mid;
+            child = mid;
+        }
+        p += common;
+        node = child;
+        if (!pushSuggestPath(index, depth++, node)) return;
+    }
+
+    SuggestEntry* entry = node->entry;
+    if (!entry) {
+        entry = (SuggestEntry*)calloc(1, sizeof(SuggestEntry));
+        if (!entry) return;
+        entry->url = url;
+        node->entry = entry;
+        index->entries++;
+    }
+    // visits made at once weigh visits times one
+    double weight = (double)index->clock / FRECENCY_HALF_LIFE + log2((double)visits);
+    double previous = entry->score;
+    index->clock += visits;
+    entry->score = entry->visits == 0 ? weight
+        : weight + log2(1.0 + exp2(entry->score - weight));
+    entry->visits += visits;
+    entry->last_visit = index->clock;
+    if (entry->score < previous) {
+        // Only a forgotten entry restarts lower; relist the path bottom-up.
+        for (int i = depth - 1; i >= 0; i--) refillTopSuggestions(index->path[i]);
+        return;
+    }
+    for (int i = 0; i < depth; i++) {
+        updateTopSuggestions(index->path[i], entry);
+    }
+}
+
+// Fills out with up to MAX_SUGGESTIONS entries starting with prefix, best
+// first, and returns how many were found.
+int findSuggestions(SuggestIndex* index, const char* prefix, SuggestEntry** out) {
+    TrieNode* node = index->root;
+    const char* p = prefix;
+    while (node && *p) {
+        TrieNode* child = node->child;
+        while (child && child->label[0] != *p) child = child->sibling;
+        if (!child) return 0;
+        int n = 0;
+        while (n < child->label_len && p[n] && p[n] == child->label[n]) n++;
+        if (n < child->label_len && p[n]) return 0;
+        p += n;
+        node = child;
+    }
+    if (!node) return 0;
+    memcpy(out, node->top, node->top_count * sizeof(SuggestEntry*));
+    return node->top_count;
+}
+
+// Marks url as never visited, until it is visited again or the index is
+// rebuilt. Its entry stays in the trie but leaves the lists on its path,
+// which are refilled from the rest of each subtree.
+void forgetVisits(SuggestIndex* index, UrlId url) {
+    TrieNode* node = index->root;
+    const char* p = urlText(url);
+    int depth = 0;
+    if (!node || !pushSuggestPath(index, depth++, node)) return;
+    while (*p) {
+        TrieNode* child = node->child;
+        while (child && child->label[0] != *p) child = child->sibling;
+        if (!child || strncmp(p, child->label, child->label_len) != 0) return;
+        p += child->label_len;
+        node = child;
+        if (!pushSuggestPath(index, depth++, node)) return;
+    }
+    if (!node->entry || node->entry->visits == 0) return;
+    node->entry->visits = 0;
+    for (int i = depth - 1; i >= 0; i--) refillTopSuggestions(index->path[i]);
+}
+
+void freeTrie(TrieNode* node) {
+    while (node) {
+        TrieNode* next = node->sibling;
+        freeTrie(node->child);
+        free(node->entry);
+        free(node->label);
+        free(node);
+        node = next;
+    }
+}
+
+void freeSuggestIndex(SuggestIndex* index) {
+    freeTrie(index->root);
+    free(index->path);
+    initSuggestIndex(index);
+}
+
+// History Search Index
+// Inverted index from every trigram (three consecutive bytes) of a URL to
+// the history entries containing it. A keyword of three or more characters
+// is answered by intersecting the posting lists of its trigrams, smallest
+// first, and confirming the survivors with strstr.
+void initTrigramIndex(TrigramIndex* index) {
+    index->slots = NULL;
+    index->capacity = 0;
+    index->used = 0;
+}
+
+unsigned int trigramKey(const char* s) {
+    return ((unsigned int)(unsigned char)s[0] << 16) |
+           ((unsigned int)(unsigned char)s[1] << 8) |
+           (unsigned int)(unsigned char)s[2];
+}
+
+PostingList* findPostingList(TrigramIndex* index, unsigned int key) {
+    if (index->capacity == 0) return NULL;
+    unsigned int mask = (unsigned int)index->capacity - 1;
+    unsigned int i = (key * 2654435761u) & mask;
+    while (index->slots[i].key != 0) {
+        if (index->slots[i].key == key) return &index->slots[i];
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+PostingList* getPostingList(TrigramIndex* index, unsigned int key) {
+    PostingList* list = findPostingList(index, key);
+    if (list) return list;
+    if ((index->used + 1) * 2 > index->capacity) {
+        int capacity = index->capacity ? index->capacity * 2 : 1024;
+        PostingList* slots = (PostingList*)calloc(capacity, sizeof(PostingList));
+        if (!slots) return NULL;
+        for (int i = 0; i < index->capacity; i++) {
+            if (index->slots[i].key == 0) continue;
+            unsigned int j = (index->slots[i].key * 2654435761u) & (unsigned int)(capacity - 1);
+            while (slots[j].key != 0) j = (j + 1) & (unsigned int)(capacity - 1);
+            slots[j] = index->slots[i];
+        }
+        free(index->slots);
+        index->slots = slots;
+        index->capacity = capacity;
+    }
+    unsigned int mask = (unsigned int)index->capacity - 1;
+    unsigned int i = (key * 2654435761u) & mask;
+    while (index->slots[i].key != 0) i = (i + 1) & mask;
+    index->slots[i].key = key;
+    index->used++;
+    return &index->slots[i];
+}
+
+void indexHistoryEntry(TrigramIndex* index, HistoryEntry* node) {
+    for (const char* p = urlText(node->url); p[0] && p[1] && p[2]; p++) {
+        PostingList* list = getPostingList(index, trigramKey(p));
+        if (!list) return;
+        // A URL repeating a trigram is listed once; it is always the tail.
+        if (list->count > 0 && list->nodes[list->count - 1] == node) continue;
+        if (list->count == list->capacity) {
+            int capacity = list->capacity ? list->capacity * 2 : 4;
+            HistoryEntry** nodes = (HistoryEntry**)realloc(list->nodes, capacity * sizeof(HistoryEntry*));
+            if (!nodes) return;
+            list->nodes = nodes;
+            list->capacity = capacity;
+        }
+        list->nodes[list->count++] = node;
+    }
+}
+
+// Returns the history entries containing keyword as a malloc'd array the
+// caller frees. *count receives the number of matches.
+HistoryEntry** findInHistory(HistoryList* history, const char* keyword, int* count) {
+    *count = 0;
+    int len = (int)strlen(keyword);
+    if (len < 3) {
+        HistoryEntry** matches = (HistoryEntry**)malloc((history->size + 1) * sizeof(HistoryEntry*));
+        if (!matches) return NULL;
+        for (HistoryEntry* temp = history->oldest; temp; temp = temp->next) {
+            if (strstr(urlText(temp->url), keyword)) matches[(*count)++] = temp;
+        }
+        return matches;
+    }
+
+    int lists_count = len - 2;
+    PostingList** lists = (PostingList**)malloc(lists_count * sizeof(PostingList*));
+    if (!lists) return NULL;
+    for (int i = 0; i < lists_count; i++) {
+        lists[i] = findPostingList(&history->search, trigramKey(keyword + i));
+        if (!lists[i]) {
+            free(lists);
+            return (HistoryEntry**)malloc(sizeof(HistoryEntry*));
+        }
+        for (int j = i; j > 0 && lists[j]->count < lists[j - 1]->count; j--) {
+            PostingList* t = lists[j];
+            lists[j] = lists[j - 1];
+            lists[j - 1] = t;
+        }
+    }
+
+    HistoryEntry** matches = (HistoryEntry**)malloc((lists[0]->count + 1) * sizeof(HistoryEntry*));
+    if (!matches) {
+        free(lists);
+        return NULL;
+    }
+    int* cursor = (int*)calloc(lists_count, sizeof(int));
+    if (!cursor) {
+        free(lists);
+        free(matches);
+        return NULL;
+    }
+    for (int c = 0; c < lists[0]->count; c++) {
+        HistoryEntry* candidate = lists[0]->nodes[c];
+        int present = 1;
+        for (int i = 1; i < lists_count && present; i++) {
+            // Posting lists are sorted by seq: binary search forward.
+            int lo = cursor[i], hi = lists[i]->count;
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                if (lists[i]->nodes[mid]->seq < candidate->seq) lo = mid + 1;
+                else hi = mid;
+            }
+            cursor[i] = lo;
+            present = lo < lists[i]->count && lists[i]->nodes[lo] == candidate;
+        }
+        if (present && candidate->visits > 0 && strstr(urlText(candidate->url), keyword)) {
+            matches[(*count)++] = candidate;
+        }
+    }
+    free(cursor);
+    free(lists);
+    return matches;
+}
+
+void freeTrigramIndex(TrigramIndex* index) {
+    for (int i = 0; i < index->capacity; i++) {
+        free(index->slots[i].nodes);
+    }
+    free(index->slots);
+    initTrigramIndex(index);
+}
+
+// Navigation Model
+// First-order Markov model over consecutive history entries: for every
+// page, the pages visited right after it and how often. Rows are indexed
+// by UrlId and hold at most PREFETCH_MAX_SUCCESSORS successors; when a row
+// is full the least frequent one is replaced by the newcomer, which
+// inherits its count plus one (space-saving), so frequent successors are
+// never lost to a long tail of one-off visits.
+void initTransitionModel(TransitionModel* model) {
+    model->rows = NULL;
+    model->capacity = 0;
+    model->edges = 0;
+}
+
+void recordTransition(TransitionModel* model, UrlId from, UrlId to) {
+    if (from == NO_URL || to == NO_URL || from == to) return;
+    if (from >= model->capacity) {
+        unsigned int capacity = model->capacity ? model->capacity : 1024;
+        while (capacity <= from) capacity *= 2;
+        TransitionRow* rows = (TransitionRow*)realloc(model->rows, capacity * sizeof(TransitionRow));
+        if (!rows) return;
+        memset(rows + model->capacity, 0, (capacity - model->capacity) * sizeof(TransitionRow));
+        model->rows = rows;
+        model->capacity = capacity;
+    }
+    TransitionRow* row = &model->rows[from];
+    row->total++;
+    Transition* least = NULL;
+    for (int i = 0; i < row->count; i++) {
+        if (row->next[i].url == to) {
+            row->next[i].count++;
+            return;
+        }
+        if (!least || row->next[i].count < least->count) least = &row->next[i];
+    }
+    if (row->count == row->capacity && row->capacity < PREFETCH_MAX_SUCCESSORS) {
+        int capacity = row->capacity ? row->capacity * 2 : 2;
+        if (capacity > PREFETCH_MAX_SUCCESSORS) capacity = PREFETCH_MAX_SUCCESSORS;
+        Transition* next = (Transition*)realloc(row->next, capacity * sizeof(Transition));
+        if (next) {
+            row->next = next;
+            row->capacity = (unsigned short)capacity;
+        }
+    }
+    if (row->count < row->capacity) {
+        row->next[row->count].url = to;
+        row->next[row->count].count = 1;
+        row->count++;
+        model->edges++;
+    } else if (least) {
+        least->url = to;
+        least->count++;
+    }
+}
+
+// Writes up to max likely successors of from into out, most likely first.
+// A successor qualifies once it was seen PREFETCH_MIN_COUNT times and
+// makes up PREFETCH_MIN_PERCENT of the page's transitions.
+int predictNext(TransitionModel* model, UrlId from, UrlId* out, int max) {
+    if (from >= model->capacity) return 0;
+    TransitionRow* row = &model->rows[from];
+    unsigned int counts[PREFETCH_FANOUT];
+    int found = 0;
+    if (max > PREFETCH_FANOUT) max = PREFETCH_FANOUT;
+    for (int i = 0; i < row->count; i++) {
+        unsigned int count = row->next[i].count;
+        if (count < PREFETCH_MIN_COUNT || count * 100 < row->total * PREFETCH_MIN_PERCENT) continue;
+        int pos = found < max ? found++ : max;
+        while (pos > 0 && counts[pos - 1] < count) {
+            if (pos < max) {
+                counts[pos] = counts[pos - 1];
+                out[pos] = out[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < max) {
+            counts[pos] = count;
+            out[pos] = row->next[i].url;
+        }
+    }
+    return found;
+}
+
+void freeTransitionModel(TransitionModel* model) {
+    for (unsigned int i = 0; i < model->capacity; i++) free(model->rows[i].next);
+    free(model->rows);
+    initTransitionModel(model);
+}
+
+// Hands the pages most likely to be visited after current to the loader
+// pool, which warms them into the cache; the idle point itself does no
+// I/O. A round stores at most prefetch_budget bytes of cache entries, and
+// a new round starts only once the previous one has finished.
+void prefetchPages(LoaderPool* pool, HistoryList* history, UrlId current) {
+    if (prefetch_budget < sizeof(CacheNode) || __atomic_load_n(&pool->prefetching, __ATOMIC_ACQUIRE) > 0) return;
+    UrlId next[PREFETCH_FANOUT];
+    int count = predictNext(&history->transitions, current, next, PREFETCH_FANOUT);
+    __atomic_store_n(&pool->prefetch_spent, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < count; i++) {
+        if (!cacheContains(pool->cache, next[i])) submitLoad(pool, next[i], NULL, 1);
+    }
+}
+
+// Tab Management
+void initTabs(TabList* tabs) {
+    tabs->items = NULL;
+    tabs->tab_count = 0;
+    tabs->capacity = 0;
+    tabs->current_index = -1;
+    tabs->current = NULL;
+    tabs->lru_head = tabs->lru_tail = NULL;
+    tabs->hibernated = 0;
+    tabs->hibernations = 0;
+    tabs->restores = 0;
+    initPool(&tabs->nodes, sizeof(TabNode));
+}
+
+void unlinkTab(TabList* tabs, TabNode* tab) {
+    if (tab->lru_prev) tab->lru_prev->lru_next = tab->lru_next;
+    else tabs->lru_head = tab->lru_next;
+    if (tab->lru_next) tab->lru_next->lru_prev = tab->lru_prev;
+    else tabs->lru_tail = tab->lru_prev;
+    tab->lru_prev = tab->lru_next = NULL;
+}
+
+// Marks tab as just shown. A hibernated tab wakes up here; its page is
+// loaded again (from the disk cache when it is there) the next time it
+// is displayed.
+void activateTab(TabList* tabs, TabNode* tab) {
+    if (tab->hibernated) {
+        tab->hibernated = 0;
+        if (tab->url != NO_URL) urlEntry(tab->url)->awake_tabs++;
+        tabs->hibernated--;
+        tabs->restores++;
+    } else if (tabs->lru_head == tab) {
+        tab->last_active = nowMs();
+        return;
+    } else if (tab->lru_prev) {
+        unlinkTab(tabs, tab);
+    }
+    tab->lru_prev = NULL;
+    tab->lru_next = tabs->lru_head;
+    if (tabs->lru_head) tabs->lru_head->lru_prev = tab;
+    tabs->lru_head = tab;
+    if (!tabs->lru_tail) tabs->lru_tail = tab;
+    tab->last_active = nowMs();
+}
+
+void addTab(TabList* tabs, const char* url) {
+    if (tabs->tab_count == tabs->capacity) {
+        int capacity = tabs->capacity ? tabs->capacity * 2 : 16;
+        TabNode** items = (TabNode**)realloc(tabs->items, capacity * sizeof(TabNode*));
+        if (!items) {
+            uiPrintf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
+            return;
+        }
+        tabs->items = items;
+        tabs->capacity = capacity;
+    }
+
+    TabNode* newTab = (TabNode*)poolAlloc(&tabs->nodes);
+    if (!newTab) {
+        uiPrintf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
+        return;
+    }
+    newTab->url = NO_URL;
+    newTab->state = TAB_IDLE;
+    newTab->load_ms = 0;
+    newTab->hibernated = 0;
+    newTab->nav = NULL;
+    newTab->nav_capacity = newTab->nav_first = newTab->nav_count = newTab->nav_pos = 0;
+    newTab->lru_prev = newTab->lru_next = NULL;
+    tabNavigate(newTab, internURL(url));
+
+    tabs->current_index = tabs->tab_count;
+    tabs->items[tabs->tab_count++] = newTab;
+    tabs->current = newTab;
+    activateTab(tabs, newTab);
+}
+
+// Every URL counts the awake tabs showing it, so hibernating one tab
+// keeps the page cached while another awake tab still shows it.
+void setTabURL(TabNode* tab, UrlId url) {
+    if (!tab->hibernated) {
+        if (tab->url != NO_URL) urlEntry(tab->url)->awake_tabs--;
+        if (url != NO_URL) urlEntry(url)->awake_tabs++;
+    }
+    tab->url = url;
+}
+
+// Shows url in tab, after the page shown now. The pages ahead of it (the
+// forward entries) are dropped, and past TAB_NAV_DEPTH pages the oldest
+// one is forgotten, so going back and forward never walks anything.
+void tabNavigate(TabNode* tab, UrlId url) {
+    if (tab->nav_count > 0) tab->nav_count = tab->nav_pos + 1;
+    if (tab->nav_count == tab->nav_capacity && tab->nav_capacity < TAB_NAV_DEPTH) {
+        int capacity = tab->nav_capacity ? tab->nav_capacity * 2 : 4;
+        UrlId* nav = (UrlId*)malloc(capacity * sizeof(UrlId));
+        if (nav) {
+            for (int i = 0; i < tab->nav_count; i++) {
+                nav[i] = tab->nav[(tab->nav_first + i) & (tab->nav_capacity - 1)];
+            }
+            free(tab->nav);
+            tab->nav = nav;
+            tab->nav_capacity = capacity;
+            tab->nav_first = 0;
+        }
+    }
+    setTabURL(tab, url);
+    if (__atomic_load_n(&tab->state, __ATOMIC_ACQUIRE) != TAB_LOADING) {
+        __atomic_store_n(&tab->state, TAB_IDLE, __ATOMIC_RELEASE);
+    }
+    if (tab->nav_capacity == 0) return;
+    if (tab->nav_count == tab->nav_capacity) {
+        tab->nav_first = (tab->nav_first + 1) & (tab->nav_capacity - 1);
+        tab->nav_count--;
+    }
+    tab->nav_pos = tab->nav_count++;
+    tab->nav[(tab->nav_first + tab->nav_pos) & (tab->nav_capacity - 1)] = url;
+}
+
+// Moves delta pages back (negative) or forward in tab. Returns the page
+// now shown, or NO_URL when there is none that far.
+UrlId tabStep(TabNode* tab, int delta) {
+    int pos = tab->nav_pos + delta;
+    if (pos < 0 || pos >= tab->nav_count) return NO_URL;
+    tab->nav_pos = pos;
+    setTabURL(tab, tab->nav[(tab->nav_first + pos) & (tab->nav_capacity - 1)]);
+    if (__atomic_load_n(&tab->state, __ATOMIC_ACQUIRE) != TAB_LOADING) {
+        __atomic_store_n(&tab->state, TAB_IDLE, __ATOMIC_RELEASE);
+    }
+    return tab->url;
+}
+
+void switchTab(TabList* tabs, int index) {
+    if (index < 1 || index > tabs->tab_count) {
+        uiPrintf(ANSI_COLOR_RED "Invalid tab index!\n" ANSI_COLOR_RESET);
+        return;
+    }
+    tabs->current_index = index - 1;
+    tabs->current = tabs->items[index - 1];
+    activateTab(tabs, tabs->current);
+}
+
+// Puts tabs idle for longer than hibernate_after_ms to sleep by dropping
+// their pages from the memory cache (dropped pages go to the disk cache),
+// so memory follows the tabs in use rather than the tabs open. A page an
+// awake tab still shows stays cached. Runs at the idle point and only
+// looks at the least recently active end of the list. Tabs still loading
+// are left until their load finishes.
+void hibernateTabs(TabList* tabs, HashTable* cache) {
+    if (hibernate_after_ms <= 0) return;
+    double cutoff = nowMs() - hibernate_after_ms;
+    while (tabs->lru_tail && tabs->lru_tail != tabs->current && tabs->lru_tail->last_active < cutoff) {
+        TabNode* tab = tabs->lru_tail;
+        if (__atomic_load_n(&tab->state, __ATOMIC_ACQUIRE) == TAB_LOADING) break;
+        unlinkTab(tabs, tab);
+        tab->hibernated = 1;
+        tabs->hibernated++;
+        tabs->hibernations++;
+        if (tab->url != NO_URL && --urlEntry(tab->url)->awake_tabs == 0) cacheDrop(cache, tab->url);
+    }
+}
+
+void freeTabs(TabList* tabs) {
+    for (int i = 0; i < tabs->tab_count; i++) {
+        setTabURL(tabs->items[i], NO_URL);
+        free(tabs->items[i]->nav);
+    }
+    poolReleaseAll(&tabs->nodes);
+    free(tabs->items);
+    initTabs(tabs);
+}
+
+// Lists TAB_VIEW_ENTRIES tabs around the current one.
+void showTabs(TabList* tabs) {
+    uiRegion(REGION_TABS);
+    uiPrintf("%s", TEXT_COLOR[theme]);
+    uiPrintf("Open Tabs:\n");
+    uiPrintf("----------------\n");
+    if (tabs->tab_count == 0) {
+        uiPrintf("No tabs open!\n");
+    } else {
+        int first = tabs->current_index - TAB_VIEW_ENTRIES / 2;
+        if (first > tabs->tab_count - TAB_VIEW_ENTRIES) first = tabs->tab_count - TAB_VIEW_ENTRIES;
+        if (first < 0) first = 0;
+        int last = first + TAB_VIEW_ENTRIES;
+        if (last > tabs->tab_count) last = tabs->tab_count;
+        if (first > 0) uiPrintf("  ... %d earlier tab%s\n", first, first == 1 ? "" : "s");
+        for (int i = first; i < last; i++) {
+            TabNode* tab = tabs->items[i];
+            uiPrintf("%s%d. %s", (tab == tabs->current) ? "> " : "  ", i + 1, urlText(tab->url));
+            int state = __atomic_load_n(&tab->state, __ATOMIC_ACQUIRE);
+            if (tab->hibernated) uiPrintf(ANSI_COLOR_BLUE " [hibernated]%s", TEXT_COLOR[theme]);
+            else if (state == TAB_LOADING) uiPrintf(ANSI_COLOR_YELLOW " [loading]%s", TEXT_COLOR[theme]);
+            else if (state == TAB_FAILED) uiPrintf(ANSI_COLOR_RED " [failed]%s", TEXT_COLOR[theme]);
+            else if (state == TAB_READY) uiPrintf(" [%.1f ms]", tab->load_ms);
+            uiPrintf("\n");
+        }
+        if (last < tabs->tab_count) {
+            int more = tabs->tab_count - last;
+            uiPrintf("  ... %d more tab%s\n", more, more == 1 ? "" : "s");
+        }
+        if (tabs->hibernated > 0) uiPrintf("  (%d of %d tabs hibernated)\n", tabs->hibernated, tabs->tab_count);
+    }
+    uiPrintf("----------------\n\n");
+    uiPrintf("%s", ANSI_COLOR_RESET);
+}
+
+// Background Loader Pool
+// Worker threads that load pages into the cache so tabs can be refreshed
+// without blocking the UI. Every worker owns a deque: tasks are submitted
+// round-robin to the bottom of the deques, a worker pops its own newest
+// task first and, when its deque is empty, steals the oldest task from
+// another worker. Idle workers sleep on one condition variable until
+// tasks are queued. Each deque has its own mutex, so contention is limited
+// to a thief and an owner meeting on the same deque.
+int loaderWorkerCount() {
+    #ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        int cores = (int)info.dwNumberOfProcessors;
+    #else
+        int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    #endif
+    if (cores < 1) cores = 1;
+    return cores > LOADER_MAX_WORKERS ? LOADER_MAX_WORKERS : cores;
+}
+
+void pushLoadTask(LoadDeque* deque, LoadTask task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom - deque->top == deque->capacity) {
+        int capacity = deque->capacity ? deque->capacity * 2 : 64;
+        LoadTask* tasks = (LoadTask*)malloc(capacity * sizeof(LoadTask));
+        if (!tasks) {
+            pthread_mutex_unlock(&deque->lock);
+            return;
+        }
+        for (long i = deque->top; i < deque->bottom; i++) {
+            tasks[i & (capacity - 1)] = deque->tasks[i & (deque->capacity - 1)];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+    }
+    deque->tasks[deque->bottom & (deque->capacity - 1)] = task;
+    deque->bottom++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// Owner end: newest task first.
+int popLoadTask(LoadDeque* deque, LoadTask* task) {
+    pthread_mutex_lock(&deque->lock);
+    int found = deque->bottom > deque->top;
+    if (found) {
+        deque->bottom--;
+        *task = deque->tasks[deque->bottom & (deque->capacity - 1)];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Thief end: oldest task first.
+int stealLoadTask(LoadDeque* deque, LoadTask* task) {
+    if (pthread_mutex_trylock(&deque->lock) != 0) return 0; // busy: try another victim
+    int found = deque->bottom > deque->top;
+    if (found) {
+        *task = deque->tasks[deque->top & (deque->capacity - 1)];
+        deque->top++;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+void runLoadTask(LoaderPool* pool, LoadTask* task) {
+    const char* span = task->prefetch ? "prefetch page" : "load task";
+    TRACE_BEGIN(span);
+    Page page = { NULL, 0, 0, 0, 0 };
+    double start = nowMs();
+    int ok = 0;
+    if (!task->prefetch) {
+        ok = producePage(task->url, &page);
+        if (ok) storeInCache(pool->cache, task->url, &page, 0);
+    } else if (__atomic_load_n(&pool->prefetch_spent, __ATOMIC_RELAXED) + sizeof(CacheNode) <= prefetch_budget) {
+        if (producePage(task->url, &page)) {
+            size_t stored = storeInCache(pool->cache, task->url, &page, 1);
+            __atomic_fetch_add(&pool->prefetch_spent, stored, __ATOMIC_RELAXED);
+        }
+    }
+    freePage(&page);
+    if (task->tab) {
+        task->tab->load_ms = nowMs() - start;
+        __atomic_store_n(&task->tab->state, ok ? TAB_READY : TAB_FAILED, __ATOMIC_RELEASE);
+    }
+    if (task->prefetch) __atomic_fetch_sub(&pool->prefetching, 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&pool->completed, 1, __ATOMIC_RELEASE);
+    TRACE_END(span);
+}
+
+void* loaderWorker(void* arg) {
+    LoaderWorker* self = (LoaderWorker*)arg;
+    LoaderPool* pool = self->pool;
+    LoadTask task;
+    TRACE_THREAD("loader");
+    while (1) {
+        int found = popLoadTask(&self->deque, &task);
+        for (int i = 1; !found && i < pool->count; i++) {
+            found = stealLoadTask(&pool->workers[(self->index + i) % pool->count].deque, &task);
+            if (found) self->steals++;
+        }
+        if (found) {
+            __atomic_fetch_sub(&pool->queued, 1, __ATOMIC_ACQ_REL);
+            runLoadTask(pool, &task);
+            self->tasks++;
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        while (pool->running && __atomic_load_n(&pool->queued, __ATOMIC_ACQUIRE) == 0) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        int running = pool->running;
+        pthread_mutex_unlock(&pool->lock);
+        if (!running) return NULL;
+    }
+}
+
+int initLoaderPool(LoaderPool* pool, HashTable* cache, int workers) {
+    memset(pool, 0, sizeof(*pool));
+    pool->cache = cache;
+    pool->running = 1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    if (workers < 1) workers = 1;
+    if (workers > LOADER_MAX_WORKERS) workers = LOADER_MAX_WORKERS;
+    for (int i = 0; i < workers; i++) {
+        LoaderWorker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        pthread_mutex_init(&worker->deque.lock, NULL);
+    }
+    pool->count = workers;
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, loaderWorker, &pool->workers[i]) != 0) {
+            pool->count = i; // a smaller pool still works
+            break;
+        }
+    }
+    return pool->count;
+}
+
+// Queues a page load; tab (may be NULL) shows the loading state. A
+// prefetch load is stored as prefetched and counts against the budget.
+void submitLoad(LoaderPool* pool, UrlId url, TabNode* tab, int prefetch) {
+    if (pool->count == 0) return;
+    if (tab) __atomic_store_n(&tab->state, TAB_LOADING, __ATOMIC_RELEASE);
+    if (prefetch) __atomic_fetch_add(&pool->prefetching, 1, __ATOMIC_ACQ_REL);
+    LoadTask task = { url, tab, prefetch };
+    __atomic_fetch_add(&pool->queued, 1, __ATOMIC_ACQ_REL);
+    pushLoadTask(&pool->workers[pool->next++ % pool->count].deque, task);
+    __atomic_fetch_add(&pool->submitted, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Blocks until every submitted task has finished; for benchmarks and exit.
+void waitLoaderPool(LoaderPool* pool) {
+    while (__atomic_load_n(&pool->completed, __ATOMIC_ACQUIRE) < pool->submitted) {
+        #ifdef _WIN32
+            Sleep(1);
+        #else
+            usleep(200);
+        #endif
+    }
+}
+
+// Stops the workers; tasks still queued are dropped.
+void shutdownLoaderPool(LoaderPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->running = 0;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        free(pool->workers[i].deque.tasks);
+        pthread_mutex_destroy(&pool->workers[i].deque.lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pool->count = 0;
+}
+
+// Reloads every open tab in the background. Hibernated tabs are left
+// asleep; they load when they are switched to.
+void refreshAllTabs(LoaderPool* pool, TabList* tabs) {
+    for (int i = 0; i < tabs->tab_count; i++) {
+        if (!tabs->items[i]->hibernated) submitLoad(pool, tabs->items[i]->url, tabs->items[i], 0);
+    }
+}
+
+// Page Buffers
+// Pages are heap buffers of any length up to PAGE_MAX_LEN, always
+// NUL-terminated so they can be printed directly.
+int pageReserve(Page* page, size_t length) {
+    if (length + 1 <= page->capacity) return 1;
+    size_t capacity = page->capacity ? page->capacity : 256;
+    while (capacity < length + 1) capacity *= 2;
+    char* text = (char*)realloc(page->text, capacity);
+    if (!text) return 0;
+    page->text = text;
+    page->capacity = capacity;
+    return 1;
+}
+
+void pageSet(Page* page, const char* text, size_t length) {
+    if (!pageReserve(page, length)) length = page->capacity ? page->capacity - 1 : 0;
+    if (page->text) {
+        memmove(page->text, text, length);
+        page->text[length] = '\0';
+    }
+    page->length = length;
+}
+
+void pagePrintf(Page* page, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    char text[1024];
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(text, sizeof(text), format, copy);
+    va_end(copy);
+    if (length < 0) length = 0;
+    if (length < (int)sizeof(text)) {
+        pageSet(page, text, (size_t)length);
+    } else if (pageReserve(page, (size_t)length)) {
+        vsnprintf(page->text, (size_t)length + 1, format, args);
+        page->length = (size_t)length;
+    }
+    va_end(args);
+}
+
+void freePage(Page* page) {
+    free(page->text);
+    page->text = NULL;
+    page->length = page->capacity = 0;
+}
+
+// Page Compression
+// LZ77 in the style of LZ4: a sequence is a token byte (literal count in
+// the high nibble, match length - LZ_MIN_MATCH in the low one, 15 meaning
+// more length bytes follow, each adding up to 255), the literals, and a
+// 16-bit little-endian offset back to the match. The last sequence has
+// literals only. Matches are found greedily through a hash of the next
+// LZ_MIN_MATCH bytes, which keeps compression fast enough to run on
+// every cache insert.
+void lzPutLength(unsigned char** out, size_t length) {
+    while (length >= 255) {
+        *(*out)++ = 255;
+        length -= 255;
+    }
+    *(*out)++ = (unsigned char)length;
+}
+
+// Appends literals and, when match_length is non-zero, one match. Returns
+// 0 if the sequence would not fit before end.
+int lzEmit(unsigned char** out, unsigned char* end, const unsigned char* literals, size_t literal_length,
+           size_t offset, size_t match_length) {
+    size_t worst = 1 + literal_length + literal_length / 255 + 1 + 2 + match_length / 255 + 1;
+    if ((size_t)(end - *out) < worst) return 0;
+    size_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+    unsigned char* token = (*out)++;
+    *token = (unsigned char)(((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15));
+    if (literal_length >= 15) lzPutLength(out, literal_length - 15);
+    memcpy(*out, literals, literal_length);
+    *out += literal_length;
+    if (match_length) {
+        *(*out)++ = (unsigned char)(offset & 0xFF);
+        *(*out)++ = (unsigned char)(offset >> 8);
+        if (match_code >= 15) lzPutLength(out, match_code - 15);
+    }
+    return 1;
+}
+
+// Compresses in into out. Returns the compressed size, or 0 if it would
+// not be smaller than capacity.
+size_t lzCompress(const unsigned char* in, size_t length, unsigned char* out, size_t capacity) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+    unsigned char* start = out;
+    unsigned char* end = out + capacity;
+    size_t anchor = 0, i = 0;
+    while (i + LZ_MIN_MATCH <= length) {
+        uint32_t sequence;
+        memcpy(&sequence, in + i, sizeof(sequence));
+        uint32_t h = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = table[h]; // position + 1, 0 when unused
+        table[h] = (uint32_t)(i + 1);
+        if (candidate-- && i - candidate <= 0xFFFF) {
+            uint32_t previous;
+            memcpy(&previous, in + candidate, sizeof(previous));
+            if (previous == sequence) {
+                size_t match = LZ_MIN_MATCH;
+                while (i + match < length && in[candidate + match] == in[i + match]) match++;
+                if (!lzEmit(&out, end, in + anchor, i - anchor, i - candidate, match)) return 0;
+                i += match;
+                anchor = i;
+                continue;
+            }
+        }
+        i++;
+    }
+    if (!lzEmit(&out, end, in + anchor, length - anchor, 0, 0)) return 0;
+    return (size_t)(out - start);
+}
+
+// Reads a length continued in 255-steps. Returns 0 on truncated input.
+int lzGetLength(const unsigned char** in, const unsigned char* end, size_t* length) {
+    unsigned char byte;
+    do {
+        if (*in >= end) return 0;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return 1;
+}
+
+// Decompresses exactly length bytes into out. Returns 0 on corrupt input.
+int lzDecompress(const unsigned char* in, size_t size, unsigned char* out, size_t length) {
+    const unsigned char* end = in + size;
+    size_t pos = 0;
+    while (in < end) {
+        unsigned char token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !lzGetLength(&in, end, &literals)) return 0;
+        if (literals > (size_t)(end - in) || literals > length - pos) return 0;
+        memcpy(out + pos, in, literals);
+        in += literals;
+        pos += literals;
+        if (in == end) break;
+        if (end - in < 2) return 0;
+        size_t offset = in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t match = token & 15;
+        if (match == 15 && !lzGetLength(&in, end, &match)) return 0;
+        match += LZ_MIN_MATCH;
+        if (offset == 0 || offset > pos || match > length - pos) return 0;
+        // An overlapping match repeats the span since its start; copy it in
+        // non-overlapping pieces that double each time.
+        const unsigned char* from = out + pos - offset;
+        for (size_t span = offset; match > 0; span *= 2) {
+            size_t copy = match < span ? match : span;
+            memcpy(out + pos, from, copy);
+            pos += copy;
+            match -= copy;
+        }
+    }
+    return pos == length;
+}
+
+// Encodes a page for the cache: LZ-compressed when that is smaller,
+// otherwise a plain copy. Returns a malloc'd blob and its size in *stored.
+unsigned char* encodePage(const char* text, size_t length, uint32_t* stored) {
+    unsigned char* data = (unsigned char*)malloc(length ? length : 1);
+    if (!data) return NULL;
+    size_t size = length >= LZ_MIN_PAGE ? lzCompress((const unsigned char*)text, length, data, length - 1) : 0;
+    if (size == 0) {
+        memcpy(data, text, length);
+        size = length;
+    } else {
+        unsigned char* shrunk = (unsigned char*)realloc(data, size);
+        if (shrunk) data = shrunk;
+    }
+    *stored = (uint32_t)size;
+    return data;
+}
+
+// Decodes a cache blob into page; a blob is compressed when it is shorter
+// than its page. Returns 0 if the blob is damaged.
+int decodePage(const unsigned char* data, uint32_t stored, uint32_t length, Page* page) {
+    if (!pageReserve(page, length)) return 0;
+    if (stored < length) {
+        if (!lzDecompress(data, stored, (unsigned char*)page->text, length)) return 0;
+    } else {
+        memcpy(page->text, data, length);
+    }
+    page->text[length] = '\0';
+    page->length = length;
+    return 1;
+}
+
+// Hash Table for URL Caching
+// Robin Hood open addressing over a power-of-two slot array, keyed by
+// UrlId. Each slot keeps 32 bits of the URL's hash so most probes never
+// touch the node.
+// Growing allocates a table twice the size and moves CACHE_MIGRATE_STEP
+// old slots per cache operation; until the old table is drained, lookups
+// check both. Entries are also threaded on a recency list, and the least
+// recently used ones are evicted once the cache exceeds its byte budget.
+void initHashTable(HashTable* cache) {
+    initSlotTable(&cache->table, CACHE_MIN_SLOTS);
+    cache->old.slots = NULL;
+    cache->old.capacity = 0;
+    cache->old.count = 0;
+    cache->migrate_pos = 0;
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
+    cache->bytes = 0;
+    cache->byte_budget = CACHE_BYTE_BUDGET;
+    cache->entries = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->prefetches = 0;
+    cache->prefetch_hits = 0;
+    cache->prefetch_wasted = 0;
+    cache->prefetch_wasted_bytes = 0;
+    cache->page_bytes = 0;
+    cache->stored_bytes = 0;
+    cache->decodes = 0;
+    cache->decode_ms = 0;
+    initPool(&cache->nodes, sizeof(CacheNode));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->disk = NULL;
+}
+
+int initSlotTable(SlotTable* table, unsigned int capacity) {
+    table->slots = (CacheSlot*)calloc(capacity, sizeof(CacheSlot));
+    table->capacity = table->slots ? capacity : 0;
+    table->count = 0;
+    return table->slots != NULL;
+}
+
+// Inserts a node known to be absent; the table must have a free slot.
+void insertSlot(SlotTable* table, CacheNode* node) {
+    unsigned int mask = table->capacity - 1;
+    CacheSlot entry = { node, (unsigned int)node->hash, 0 };
+    unsigned int i = entry.hash & mask;
+    while (table->slots[i].node) {
+        if (table->slots[i].dist < entry.dist) {
+            // Robin Hood: the richer entry moves on.
+            CacheSlot displaced = table->slots[i];
+            table->slots[i] = entry;
+            entry = displaced;
+        }
+        i = (i + 1) & mask;
+        entry.dist++;
+    }
+    table->slots[i] = entry;
+    table->count++;
+}
+
+CacheSlot* findSlot(SlotTable* table, unsigned long long hash, UrlId url) {
+    if (table->count == 0) return NULL;
+    unsigned int mask = table->capacity - 1;
+    unsigned int i = (unsigned int)hash & mask;
+    for (unsigned int dist = 0;; dist++, i = (i + 1) & mask) {
+        CacheSlot* slot = &table->slots[i];
+        if (!slot->node) {
+            if (slot->dist == CACHE_SLOT_MOVED) continue;
+            return NULL;
+        }
+        if (slot->dist < dist) return NULL;
+        if (slot->hash == (unsigned int)hash && slot->node->url == url) {
+            return slot;
+        }
+    }
+}
+
+// Removes a slot with backward-shift deletion, or leaves a tombstone in a
+// table that is being migrated so its probe sequences stay intact.
+void removeSlot(SlotTable* table, CacheSlot* slot, int tombstone) {
+    table->count--;
+    if (tombstone) {
+        slot->node = NULL;
+        slot->dist = CACHE_SLOT_MOVED;
+        return;
+    }
+    unsigned int mask = table->capacity - 1;
+    unsigned int i = (unsigned int)(slot - table->slots);
+    unsigned int next = (i + 1) & mask;
+    while (table->slots[next].node && table->slots[next].dist > 0) {
+        table->slots[i] = table->slots[next];
+        table->slots[i].dist--;
+        i = next;
+        next = (next + 1) & mask;
+    }
+    table->slots[i].node = NULL;
+    table->slots[i].dist = 0;
+}
+
+// Moves up to steps slots of the table being drained into the new one.
+void migrateCacheSlots(HashTable* cache, unsigned int steps) {
+    if (!cache->old.slots) return;
+    while (steps-- > 0 && cache->migrate_pos < cache->old.capacity) {
+        CacheSlot* slot = &cache->old.slots[cache->migrate_pos++];
+        if (slot->node) {
+            insertSlot(&cache->table, slot->node);
+            removeSlot(&cache->old, slot, 1);
+        }
+    }
+    if (cache->migrate_pos == cache->old.capacity) {
+        free(cache->old.slots);
+        cache->old.slots = NULL;
+        cache->old.capacity = 0;
+        cache->old.count = 0;
+    }
+}
+
+// Starts an incremental resize once the table passes its load factor.
+void growCache(HashTable* cache) {
+    if ((cache->table.count + 1) * 5 < cache->table.capacity * 4) return;
+    if (cache->old.slots) migrateCacheSlots(cache, cache->old.capacity); // finish the last resize
+    SlotTable grown;
+    if (!initSlotTable(&grown, cache->table.capacity * 2)) return;
+    cache->old = cache->table;
+    cache->table = grown;
+    cache->migrate_pos = 0;
+}
+
+CacheNode* findCacheNode(HashTable* cache, UrlId url) {
+    migrateCacheSlots(cache, CACHE_MIGRATE_STEP);
+    unsigned long long hash = urlHash(url);
+    CacheSlot* slot = findSlot(&cache->table, hash, url);
+    if (!slot && cache->old.slots) slot = findSlot(&cache->old, hash, url);
+    return slot ? slot->node : NULL;
+}
+
+// Moves node to the most recently used end of the LRU list.
+void touchCacheNode(HashTable* cache, CacheNode* node) {
+    if (cache->lru_head == node) return;
+    if (node->lru_prev) node->lru_prev->lru_next = node->lru_next;
+    if (node->lru_next) node->lru_next->lru_prev = node->lru_prev;
+    if (cache->lru_tail == node) cache->lru_tail = node->lru_prev;
+    node->lru_prev = NULL;
+    node->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = node;
+    cache->lru_head = node;
+    if (!cache->lru_tail) cache->lru_tail = node;
+}
+
+// Takes node out of the table and the LRU list and its bytes out of the
+// totals. The caller frees it.
+void unlinkCacheNode(HashTable* cache, CacheNode* node) {
+    CacheSlot* slot = findSlot(&cache->table, node->hash, node->url);
+    if (slot) {
+        removeSlot(&cache->table, slot, 0);
+    } else if ((slot = findSlot(&cache->old, node->hash, node->url))) {
+        removeSlot(&cache->old, slot, 1);
+    }
+    if (node->lru_prev) node->lru_prev->lru_next = node->lru_next;
+    else cache->lru_head = node->lru_next;
+    if (node->lru_next) node->lru_next->lru_prev = node->lru_prev;
+    else cache->lru_tail = node->lru_prev;
+    cache->bytes -= sizeof(CacheNode) + node->stored;
+    cache->page_bytes -= node->length;
+    cache->stored_bytes -= node->stored;
+    cache->entries--;
+}
+
+void evictCacheNode(HashTable* cache, CacheNode* node) {
+    unlinkCacheNode(cache, node);
+    cache->evictions++;
+    if (node->prefetched) {
+        cache->prefetch_wasted++;
+        cache->prefetch_wasted_bytes += sizeof(CacheNode) + node->stored;
+    } else if (cache->disk) {
+        diskCacheStore(cache->disk, node->url, node->data, node->stored, node->length);
+    }
+    free(node->data);
+    poolFree(&cache->nodes, node);
+}
+
+// Changes the byte budget, evicting least recently used pages to fit.
+void setCacheBudget(HashTable* cache, size_t bytes) {
+    cache->byte_budget = bytes;
+    while (cache->lru_tail && cache->bytes > cache->byte_budget) {
+        evictCacheNode(cache, cache->lru_tail);
+    }
+}
+
+// Stores a blob made by encodePage, which the cache takes over (and frees
+// if it cannot be stored). Returns the cache entry, or NULL.
+CacheNode* addEncodedToCache(HashTable* cache, UrlId url, unsigned char* data, uint32_t stored, uint32_t length) {
+    CacheNode* node = findCacheNode(cache, url);
+    if (!node) {
+        growCache(cache);
+        if (cache->table.count >= cache->table.capacity) {
+            free(data);
+            return NULL;
+        }
+        node = (CacheNode*)poolAlloc(&cache->nodes);
+        if (!node) {
+            free(data);
+            return NULL;
+        }
+        node->url = url;
+        node->hash = urlHash(url);
+        node->lru_prev = node->lru_next = NULL;
+        node->data = NULL;
+        node->stored = node->length = 0;
+        insertSlot(&cache->table, node);
+        cache->bytes += sizeof(CacheNode);
+        cache->entries++;
+    }
+    free(node->data);
+    cache->bytes += (size_t)stored - node->stored;
+    cache->page_bytes += (unsigned long long)length - node->length;
+    cache->stored_bytes += (unsigned long long)stored - node->stored;
+    node->data = data;
+    node->stored = stored;
+    node->length = length;
+    node->prefetched = 0;
+    touchCacheNode(cache, node);
+    while (cache->lru_tail != node && cache->bytes > cache->byte_budget) {
+        evictCacheNode(cache, cache->lru_tail);
+    }
+    return node;
+}
+
+CacheNode* addToCache(HashTable* cache, UrlId url, const char* content, size_t length) {
+    uint32_t stored;
+    unsigned char* data = encodePage(content, length, &stored);
+    return data ? addEncodedToCache(cache, url, data, stored, (uint32_t)length) : NULL;
+}
+
+// Decodes the cached page for url into page. Returns 0 on a miss.
+int getFromCache(HashTable* cache, UrlId url, Page* page) {
+    CacheNode* node = findCacheNode(cache, url);
+    if (!node) {
+        cache->misses++;
+        return 0;
+    }
+    double start = nowMs();
+    if (!decodePage(node->data, node->stored, node->length, page)) {
+        evictCacheNode(cache, node);
+        cache->misses++;
+        return 0;
+    }
+    double elapsed = nowMs() - start;
+    page->stored = node->stored;
+    page->decode_us = elapsed * 1000.0;
+    cache->decodes++;
+    cache->decode_ms += elapsed;
+    touchCacheNode(cache, node);
+    cache->hits++;
+    if (node->prefetched) {
+        node->prefetched = 0;
+        cache->prefetch_hits++;
+    }
+    return 1;
+}
+
+// Entry points for code that may run next to the loader threads. The
+// functions above are not synchronized; these hold the cache lock and
+// copy pages in and out instead of handing out pointers into the cache.
+// A lookup that misses memory is tried on the disk cache.
+int cacheLookup(HashTable* cache, UrlId url, Page* page) {
+    pthread_mutex_lock(&cache->lock);
+    int found = getFromCache(cache, url, page);
+    uint32_t stored, length;
+    unsigned char* data = found || !cache->disk ? NULL : diskCacheLoad(cache->disk, url, &stored, &length);
+    if (data) {
+        double start = nowMs();
+        found = decodePage(data, stored, length, page);
+        page->stored = stored;
+        page->decode_us = (nowMs() - start) * 1000.0;
+        if (found) addEncodedToCache(cache, url, data, stored, length); // promote back to memory
+        else free(data);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
+
+int cacheContains(HashTable* cache, UrlId url) {
+    pthread_mutex_lock(&cache->lock);
+    int found = findCacheNode(cache, url) != NULL;
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
+
+// Moves url from the memory cache to the disk cache. Unlike an eviction
+// the page is still wanted, so neither the eviction nor the prefetch
+// waste counters move. Returns the bytes freed.
+size_t cacheDrop(HashTable* cache, UrlId url) {
+    pthread_mutex_lock(&cache->lock);
+    CacheNode* node = findCacheNode(cache, url);
+    size_t freed = node ? sizeof(CacheNode) + node->stored : 0;
+    if (node) {
+        unlinkCacheNode(cache, node);
+        if (cache->disk) diskCacheStore(cache->disk, node->url, node->data, node->stored, node->length);
+        free(node->data);
+        poolFree(&cache->nodes, node);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return freed;
+}
+
+// Compresses outside the lock. Returns the bytes the entry takes.
+size_t storeInCache(HashTable* cache, UrlId url, const Page* page, int prefetched) {
+    uint32_t stored;
+    unsigned char* data = encodePage(page->text, page->length, &stored);
+    if (!data) return 0;
+    pthread_mutex_lock(&cache->lock);
+    CacheNode* node = addEncodedToCache(cache, url, data, stored, (uint32_t)page->length);
+    if (node && prefetched) {
+        node->prefetched = 1;
+        cache->prefetches++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return node ? sizeof(CacheNode) + stored : 0;
+}
+
+void freeCache(HashTable* cache) {
+    for (CacheNode* node = cache->lru_head; node; node = node->lru_next) free(node->data);
+    poolReleaseAll(&cache->nodes);
+    cache->lru_head = NULL;
+    free(cache->table.slots);
+    free(cache->old.slots);
+    cache->table.slots = cache->old.slots = NULL;
+    cache->table.capacity = cache->old.capacity = 0;
+    cache->table.count = cache->old.count = 0;
+    cache->lru_tail = NULL;
+    cache->entries = 0;
+    cache->bytes = 0;
+    cache->page_bytes = 0;
+    cache->stored_bytes = 0;
+}
+
+// Disk Cache
+// Second-level page cache that survives restarts. Pages evicted from the
+// memory cache, and every cached page at exit, are appended to
+// DISK_CACHE_DATA, a fixed-size file mapped into memory and written as a
+// ring: when the write position reaches the end it wraps to the start,
+// and records of the previous lap are dropped as they are overwritten.
+// An in-memory index maps URL hashes to record offsets. It is saved to
+// DISK_CACHE_INDEX at exit and removed while the browser runs, so after a
+// crash the disk cache starts empty instead of trusting a stale index.
+// Every record carries a CRC32 of its URL and page that is checked before
+// the page is served. Called with the memory cache's lock held.
+#ifndef _WIN32
+uint32_t crc_table[256];
+
+uint32_t crc32Update(uint32_t crc, const void* data, size_t length) {
+    if (crc_table[1] == 0) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            crc_table[i] = c;
+        }
+    }
+    const unsigned char* bytes = (const unsigned char*)data;
+    crc = ~crc;
+    while (length--) crc = crc_table[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint64_t diskKey(UrlId url) {
+    uint64_t hash = urlHash(url);
+    return hash ? hash : 1; // 0 marks an empty slot
+}
+
+DiskSlot* findDiskSlot(DiskCache* disk, uint64_t key) {
+    if (disk->count == 0) return NULL;
+    unsigned int mask = disk->slot_capacity - 1;
+    for (unsigned int i = (unsigned int)key & mask; disk->slots[i].key; i = (i + 1) & mask) {
+        if (disk->slots[i].key == key) return &disk->slots[i];
+    }
+    return NULL;
+}
+
+DiskRecord* diskRecordAt(DiskCache* disk, uint64_t offset) {
+    return (DiskRecord*)(disk->data + offset);
+}
+
+// Points key at the record at offset, replacing an older record of it.
+int setDiskSlot(DiskCache* disk, uint64_t key, uint64_t offset) {
+    DiskSlot* slot = findDiskSlot(disk, key);
+    if (slot) {
+        disk->live_bytes -= diskRecordAt(disk, slot->offset)->length;
+        slot->offset = offset;
+        disk->live_bytes += diskRecordAt(disk, offset)->length;
+        return 1;
+    }
+    if ((disk->count + 1) * 10 > disk->slot_capacity * 7) {
+        unsigned int capacity = disk->slot_capacity ? disk->slot_capacity * 2 : 1024;
+        DiskSlot* slots = (DiskSlot*)calloc(capacity, sizeof(DiskSlot));
+        if (!slots) return 0;
+        for (unsigned int i = 0; i < disk->slot_capacity; i++) {
+            if (!disk->slots[i].key) continue;
+            unsigned int j = (unsigned int)disk->slots[i].key & (capacity - 1);
+            while (slots[j].key) j = (j + 1) & (capacity - 1);
+            slots[j] = disk->slots[i];
+        }
+        free(disk->slots);
+        disk->slots = slots;
+        disk->slot_capacity = capacity;
+    }
+    unsigned int mask = disk->slot_capacity - 1;
+    unsigned int i = (unsigned int)key & mask;
+    while (disk->slots[i].key) i = (i + 1) & mask;
+    disk->slots[i].key = key;
+    disk->slots[i].offset = offset;
+    disk->count++;
+    disk->live_bytes += diskRecordAt(disk, offset)->length;
+    return 1;
+}
+
+// Linear-probing delete: shifts later entries of the cluster back.
+void removeDiskSlot(DiskCache* disk, DiskSlot* slot) {
+    unsigned int mask = disk->slot_capacity - 1;
+    unsigned int i = (unsigned int)(slot - disk->slots);
+    disk->live_bytes -= diskRecordAt(disk, slot->offset)->length;
+    disk->count--;
+    for (unsigned int j = (i + 1) & mask; disk->slots[j].key; j = (j + 1) & mask) {
+        unsigned int home = (unsigned int)disk->slots[j].key & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            disk->slots[i] = disk->slots[j];
+            i = j;
+        }
+    }
+    disk->slots[i].key = 0;
+}
+
+// Drops the previous lap's records that start before end.
+void dropDiskRecords(DiskCache* disk, uint64_t end) {
+    while (disk->evict_pos < disk->limit && disk->evict_pos < end) {
+        DiskRecord* record = diskRecordAt(disk, disk->evict_pos);
+        if (record->length < sizeof(DiskRecord) || record->length % 8 != 0 ||
+            record->length > disk->limit - disk->evict_pos) {
+            disk->evict_pos = disk->limit; // unreadable tail; lookups verify anyway
+            break;
+        }
+        DiskSlot* slot = findDiskSlot(disk, record->key);
+        if (slot && slot->offset == disk->evict_pos) {
+            removeDiskSlot(disk, slot);
+            disk->drops++;
+        }
+        disk->evict_pos += record->length;
+    }
+}
+
+int loadDiskIndex(DiskCache* disk) {
+    FILE* fp = fopen(DISK_CACHE_INDEX, "rb");
+    if (!fp) return 0;
+    DiskIndexHeader header;
+    int ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+             memcmp(header.magic, DISK_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+             header.version == DISK_CACHE_VERSION && header.capacity == disk->capacity &&
+             header.head <= disk->capacity && header.limit <= disk->capacity &&
+             header.evict_pos <= header.limit;
+    if (ok) {
+        disk->head = header.head;
+        disk->limit = header.limit;
+        disk->evict_pos = header.evict_pos;
+        DiskSlot slot;
+        for (uint32_t i = 0; i < header.count && fread(&slot, sizeof(slot), 1, fp) == 1; i++) {
+            if (!slot.key || slot.offset % 8 != 0 || slot.offset + sizeof(DiskRecord) > disk->capacity) continue;
+            DiskRecord* record = diskRecordAt(disk, slot.offset);
+            if (record->key != slot.key || record->length > disk->capacity - slot.offset) continue;
+            setDiskSlot(disk, slot.key, slot.offset);
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+// Maps the data file, creating or resizing it to capacity bytes, and
+// loads the index saved by the last session. Returns 0 if the disk cache
+// could not be opened; the browser then runs without it.
+int openDiskCache(DiskCache* disk, size_t capacity) {
+    memset(disk, 0, sizeof(*disk));
+    capacity &= ~(size_t)7;
+    if (capacity < 4096) return 0;
+    int fd = open(DISK_CACHE_DATA, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return 0;
+    struct stat st;
+    int fresh = fstat(fd, &st) != 0 || (size_t)st.st_size != capacity;
+    if (fresh && ftruncate(fd, (off_t)capacity) != 0) {
+        close(fd);
+        return 0;
+    }
+    void* data = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+    disk->data = (char*)data;
+    disk->capacity = capacity;
+    if (!fresh) loadDiskIndex(disk);
+    remove(DISK_CACHE_INDEX);
+    return 1;
+}
+
+// Stores a cache blob (see encodePage) for url unless the disk already
+// holds the same one.
+int diskCacheStore(DiskCache* disk, UrlId url, const unsigned char* data, uint32_t stored, uint32_t content_length) {
+    if (!disk->data) return 0;
+    InternedURL* entry = urlEntry(url);
+    uint32_t crc = crc32Update(crc32Update(0, entry->text, entry->length), data, stored);
+    uint64_t key = diskKey(url);
+    DiskSlot* slot = findDiskSlot(disk, key);
+    if (slot) {
+        DiskRecord* old = diskRecordAt(disk, slot->offset);
+        if (old->crc == crc && old->stored_length == stored && old->content_length == content_length &&
+            old->url_length == entry->length) return 1;
+    }
+    uint64_t length = (sizeof(DiskRecord) + entry->length + stored + 7) & ~(uint64_t)7;
+    if (length > disk->capacity) return 0;
+    if (disk->head + length > disk->capacity) {
+        dropDiskRecords(disk, disk->limit); // the rest of the previous lap goes
+        disk->limit = disk->head;
+        disk->head = 0;
+        disk->evict_pos = 0;
+    }
+    dropDiskRecords(disk, disk->head + length);
+    DiskRecord* record = diskRecordAt(disk, disk->head);
+    record->key = key;
+    record->crc = crc;
+    record->url_length = entry->length;
+    record->content_length = content_length;
+    record->stored_length = stored;
+    record->length = (uint32_t)length;
+    record->reserved = 0;
+    memcpy((char*)(record + 1), entry->text, entry->length);
+    memcpy((char*)(record + 1) + entry->length, data, stored);
+    if (!setDiskSlot(disk, key, disk->head)) return 0;
+    disk->head += length;
+    disk->spills++;
+    return 1;
+}
+
+// Returns a malloc'd copy of the cache blob for url, or NULL. Records
+// that fail their checksum are dropped.
+unsigned char* diskCacheLoad(DiskCache* disk, UrlId url, uint32_t* stored, uint32_t* length) {
+    if (!disk->data) return NULL;
+    DiskSlot* slot = findDiskSlot(disk, diskKey(url));
+    if (!slot) {
+        disk->misses++;
+        return NULL;
+    }
+    DiskRecord* record = diskRecordAt(disk, slot->offset);
+    const char* text = (const char*)(record + 1);
+    uint64_t room = disk->capacity - slot->offset;
+    int intact = record->key == slot->key && record->length <= room &&
+                 sizeof(DiskRecord) + (uint64_t)record->url_length + record->stored_length <= record->length &&
+                 record->stored_length <= record->content_length && record->content_length <= PAGE_MAX_LEN &&
+                 record->crc == crc32Update(crc32Update(0, text, record->url_length),
+                                            text + record->url_length, record->stored_length);
+    if (!intact) {
+        removeDiskSlot(disk, slot);
+        disk->corrupt++;
+        disk->misses++;
+        return NULL;
+    }
+    InternedURL* entry = urlEntry(url);
+    if (record->url_length != entry->length || memcmp(text, entry->text, entry->length) != 0) {
+        disk->misses++; // another URL with the same hash
+        return NULL;
+    }
+    unsigned char* data = (unsigned char*)malloc(record->stored_length ? record->stored_length : 1);
+    if (!data) return NULL;
+    memcpy(data, text + record->url_length, record->stored_length);
+    *stored = record->stored_length;
+    *length = record->content_length;
+    disk->hits++;
+    return data;
+}
+
+// Flushes the data file, saves the index and unmaps the file.
+void closeDiskCache(DiskCache* disk) {
+    if (!disk->data) return;
+    msync(disk->data, disk->capacity, MS_SYNC);
+    FILE* fp = fopen(DISK_CACHE_INDEX ".tmp", "wb");
+    if (fp) {
+        DiskIndexHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, DISK_CACHE_MAGIC, sizeof(header.magic));
+        header.version = DISK_CACHE_VERSION;
+        header.count = disk->count;
+        header.capacity = disk->capacity;
+        header.head = disk->head;
+        header.limit = disk->limit;
+        header.evict_pos = disk->evict_pos;
+        fwrite(&header, sizeof(header), 1, fp);
+        for (unsigned int i = 0; i < disk->slot_capacity; i++) {
+            if (disk->slots[i].key) fwrite(&disk->slots[i], sizeof(DiskSlot), 1, fp);
+        }
+        fflush(fp);
+        fsync(fileno(fp));
+        int ok = !ferror(fp);
+        if (fclose(fp) == 0 && ok) rename(DISK_CACHE_INDEX ".tmp", DISK_CACHE_INDEX);
+        else remove(DISK_CACHE_INDEX ".tmp");
+    }
+    munmap(disk->data, disk->capacity);
+    free(disk->slots);
+    disk->data = NULL;
+    disk->slots = NULL;
+    disk->slot_capacity = disk->count = 0;
+}
+#else
+int openDiskCache(DiskCache* disk, size_t capacity) {
+    (void)capacity;
+    memset(disk, 0, sizeof(*disk));
+    return 0;
+}
+
+int diskCacheStore(DiskCache* disk, UrlId url, const unsigned char* data, uint32_t stored, uint32_t length) {
+    (void)disk; (void)url; (void)data; (void)stored; (void)length;
+    return 0;
+}
+
+unsigned char* diskCacheLoad(DiskCache* disk, UrlId url, uint32_t* stored, uint32_t* length) {
+    (void)disk; (void)url; (void)stored; (void)length;
+    return NULL;
+}
+
+void closeDiskCache(DiskCache* disk) {
+    (void)disk;
+}
+#endif
+
+// Writes every page of the memory cache to its disk cache, least recently
+// used first, so the most recent pages are the last to be overwritten.
+void spillCache(HashTable* cache) {
+    if (!cache->disk) return;
+    pthread_mutex_lock(&cache->lock);
+    for (CacheNode* node = cache->lru_tail; node; node = node->lru_prev) {
+        if (!node->prefetched) diskCacheStore(cache->disk, node->url, node->data, node->stored, node->length);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Bookmark Management
+// AVL tree ordered by URL. Each node also stores its subtree size, so the
+// k-th bookmark and a page of bookmarks are found in O(log n).
+BookmarkNode* initBookmarks() {
+    return NULL;
+}
+
+int bookmarkHeight(BookmarkNode* node) {
+    return node ? node->height : 0;
+}
+
+int bookmarkCount(BookmarkNode* node) {
+    return node ? node->size : 0;
+}
+
+void updateBookmarkNode(BookmarkNode* node) {
+    int left = bookmarkHeight(node->left);
+    int right = bookmarkHeight(node->right);
+    node->height = (left > right ? left : right) + 1;
+    node->size = bookmarkCount(node->left) + bookmarkCount(node->right) + 1;
+}
+
+BookmarkNode* rotateBookmarkRight(BookmarkNode* node) {
+    BookmarkNode* pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    updateBookmarkNode(node);
+    updateBookmarkNode(pivot);
+    return pivot;
+}
+
+BookmarkNode* rotateBookmarkLeft(BookmarkNode* node) {
+    BookmarkNode* pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    updateBookmarkNode(node);
+    updateBookmarkNode(pivot);
+    return pivot;
+}
+
+BookmarkNode* balanceBookmarks(BookmarkNode* node) {
+    updateBookmarkNode(node);
+    int balance = bookmarkHeight(node->left) - bookmarkHeight(node->right);
+    if (balance > 1) {
+        if (bookmarkHeight(node->left->left) < bookmarkHeight(node->left->right))
+            node->left = rotateBookmarkLeft(node->left);
+        return rotateBookmarkRight(node);
+    }
+    if (balance < -1) {
+        if (bookmarkHeight(node->right->right) < bookmarkHeight(node->right->left))
+            node->right = rotateBookmarkRight(node->right);
+        return rotateBookmarkLeft(node);
+    }
+    return node;
+}
+
+BookmarkNode* insertBookmark(BookmarkNode* root, const char* url) {
+    if (!root) {
+        BookmarkNode* newNode = (BookmarkNode*)poolAlloc(&bookmark_pool);
+        if (!newNode) {
+            uiPrintf(ANSI_COLOR_RED "Memory allocation failed!\n" ANSI_COLOR_RESET);
+            return NULL;
+        }
+        newNode->url = internURL(url);
+        newNode->left = newNode->right = NULL;
+        newNode->height = 1;
+        newNode->size = 1;
+        return newNode;
+    }
+    int cmp = strcmp(url, urlText(root->url));
+    if (cmp < 0)
+        root->left = insertBookmark(root->left, url);
+    else if (cmp > 0)
+        root->right = insertBookmark(root->right, url);
+    else
+        return root;
+    return balanceBookmarks(root);
+}
+
+int bookmarkExists(BookmarkNode* root, const char* url) {
+    UrlId id = findURL(url);
+    if (id == NO_URL) return 0;
+    while (root) {
+        if (root->url == id) return 1;
+        int cmp = strcmp(url, urlText(root->url));
+        if (cmp == 0) return 1;
+        root = cmp < 0 ? root->left : root->right;
+    }
+    return 0;
+}
+
+// Returns the bookmark at 0-based position index in URL order.
+BookmarkNode* bookmarkAt(BookmarkNode* root, int index) {
+    while (root) {
+        int left = bookmarkCount(root->left);
+        if (index < left) {
+            root = root->left;
+        } else if (index == left) {
+            return root;
+        } else {
+            index -= left + 1;
+            root = root->right;
+        }
+    }
+    return NULL;
+}
+
+static void collectBookmarkPage(BookmarkNode* node, BookmarkPage* page) {
+    if (!node || page->count >= page->limit) return;
+    int left = bookmarkCount(node->left);
+    if (page->first >= left) page->first -= left;
+    else collectBookmarkPage(node->left, page);
+    if (page->count >= page->limit) return;
+    if (page->first > 0) page->first--;
+    else page->out[page->count++] = node;
+    collectBookmarkPage(node->right, page);
+}
+
+// Copies up to limit bookmarks starting at position first into out, in URL
+// order, skipping whole subtrees that lie before the page.
+int collectBookmarks(BookmarkNode* root, int first, int limit, BookmarkNode** out) {
+    BookmarkPage page = { first, limit, 0, out };
+    collectBookmarkPage(root, &page);
+    return page.count;
+}
+
+void addBookmark(BookmarkNode** root, TabList* tabs) {
+    if (!tabs->current) {
+        uiPrintf(ANSI_COLOR_RED "No active tab to bookmark!\n" ANSI_COLOR_RESET);
+        return;
+    }
+    const char* url = urlText(tabs->current->url);
+    if (bookmarkExists(*root, url)) {
+        uiPrintf(ANSI_COLOR_RED "URL already bookmarked!\n" ANSI_COLOR_RESET);
+    } else {
+        *root = insertBookmark(*root, url);
+        journalAppend('B', url);
+        recordAction("bookmark", NULL);
+        uiPrintf(ANSI_COLOR_GREEN "Bookmark added: %s\n" ANSI_COLOR_RESET, url);
+    }
+    uiPrintf("Press Enter to continue...");
+    uiInput();
+    getchar();
+    getchar();
+}
+
+void viewBookmarks(BookmarkNode* root, HistoryList* history, TabList* tabs, HashTable* cache) {
+    int total = bookmarkCount(root);
+    int pages = (total + BOOKMARK_PAGE_SIZE - 1) / BOOKMARK_PAGE_SIZE;
+    int page = 0;
+    while (1) {
+        showHeader();
+        uiRegion(REGION_BODY);
+        uiPrintf("%sBookmarked URLs:\n", TEXT_COLOR[theme]);
+        uiPrintf("----------------\n");
+        if (!root) {
+            uiPrintf("No bookmarks yet!\n");
+            break;
+        }
+        BookmarkNode* bookmarks[BOOKMARK_PAGE_SIZE];
+        int first = page * BOOKMARK_PAGE_SIZE;
+        int count = collectBookmarks(root, first, BOOKMARK_PAGE_SIZE, bookmarks);
+        for (int i = 0; i < count; i++) {
+            uiPrintf("  %d. %s\n", first + i + 1, urlText(bookmarks[i]->url));
+        }
+        uiPrintf("----------------\n");
+        uiPrintf("Page %d of %d\n", page + 1, pages);
+        uiPrintf("Enter number to visit bookmark, n/p for next/previous page (0 to cancel): ");
+        char input[16];
+        uiInput();
+        if (scanf("%15s", input) != 1) break;
+        if (input[0] == 'n' && page + 1 < pages) {
+            page++;
+            continue;
+        }
+        if (input[0] == 'p' && page > 0) {
+            page--;
+            continue;
+        }
+        if (input[0] == 'n' || input[0] == 'p') continue;
+        int choice = atoi(input);
+        if (choice > 0 && choice <= total) {
+            const char* url = urlText(bookmarkAt(root, choice - 1)->url);
+            recordAction("visit", url);
+            navigateTo(history, tabs, url, 0);
+            fetchContent(cache, url);
+        }
+        break;
+    }
+    uiPrintf("----------------\n%s", ANSI_COLOR_RESET);
+    uiPrintf("Press Enter to continue...");
+    uiInput();
+    getchar();
+    getchar();
+}
+
+// Bookmarks all live in bookmark_pool, so the tree is released in bulk.
+void freeBookmarks(BookmarkNode* root) {
+    (void)root;
+    poolReleaseAll(&bookmark_pool);
+}
+
+// File-Based Database
+// The snapshot is browser_data.prof, a binary profile (see ProfileHeader);
+// profiles that predate it are read from the text snapshot
+// browser_data.txt. Every change after the snapshot is appended to
+// browser_data.journal and replayed on load. Snapshot and journal both
+// carry an epoch so a journal left over from an interrupted compaction is
+// never replayed on top of the snapshot that already contains it.
+
+// Writes history, bookmarks and recent visits as a binary profile. URLs
+// are stored once in the string table and referred to by index. Returns
+// the number of history and bookmark records written, or -1 on failure.
+long writeProfile(const char* path, HistoryList* history, BookmarkNode* root, long epoch) {
+    uint32_t* string_index = (uint32_t*)calloc(url_table.count + 1, sizeof(uint32_t));
+    UrlId* strings = (UrlId*)malloc((url_table.count + 1) * sizeof(UrlId));
+    uint32_t bookmark_count = (uint32_t)bookmarkCount(root);
+    BookmarkNode** bookmarks = (BookmarkNode**)malloc((bookmark_count + 1) * sizeof(BookmarkNode*));
+    FILE* fp = fopen(path, "wb");
+    long records = -1;
+    if (!string_index || !strings || !bookmarks || !fp) goto done;
+
+    // String indexes are 1-based in string_index so 0 means "not yet added".
+    uint32_t string_count = 0;
+    uint64_t text_bytes = 0;
+    uint32_t history_count = 0;
+    uint32_t recent_count = history ? (uint32_t)history->recent_count : 0;
+    for (HistoryEntry* h = history ? history->oldest : NULL; h; h = h->next, history_count++) {
+        if (!string_index[h->url]) {
+            strings[string_count] = h->url;
+            string_index[h->url] = ++string_count;
+            text_bytes += urlEntry(h->url)->length + 1;
+        }
+    }
+    collectBookmarks(root, 0, (int)bookmark_count, bookmarks);
+    for (uint32_t i = 0; i < bookmark_count + recent_count; i++) {
+        UrlId id = i < bookmark_count ? bookmarks[i]->url
+            : history->recent[(history->recent_first + i - bookmark_count) % HISTORY_RECENT_VISITS].url;
+        if (!string_index[id]) {
+            strings[string_count] = id;
+            string_index[id] = ++string_count;
+            text_bytes += urlEntry(id)->length + 1;
+        }
+    }
+
+    ProfileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROFILE_MAGIC, sizeof(header.magic));
+    header.version = PROFILE_VERSION;
+    header.header_size = sizeof(ProfileHeader);
+    header.epoch = epoch;
+    header.string_count = string_count;
+    header.history_count = history_count;
+    header.bookmark_count = bookmark_count;
+    header.recent_count = recent_count;
+    header.strings_offset = sizeof(ProfileHeader);
+    header.text_offset = header.strings_offset + (uint64_t)string_count * sizeof(ProfileString);
+    header.text_bytes = text_bytes;
+    header.history_offset = (header.text_offset + text_bytes + 7) & ~(uint64_t)7;
+    header.bookmark_offset = header.history_offset + (uint64_t)history_count * sizeof(ProfileHistory);
+    header.recent_offset = (header.bookmark_offset + (uint64_t)bookmark_count * sizeof(uint32_t) + 7) & ~(uint64_t)7;
+
+    fwrite(&header, sizeof(header), 1, fp);
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < string_count; i++) {
+        InternedURL* entry = urlEntry(strings[i]);
+        ProfileString string = { offset, entry->length, 0, entry->hash };
+        fwrite(&string, sizeof(string), 1, fp);
+        offset += entry->length + 1;
+    }
+    for (uint32_t i = 0; i < string_count; i++) {
+        InternedURL* entry = urlEntry(strings[i]);
+        fwrite(entry->text, 1, entry->length + 1, fp);
+    }
+    static const char padding[8] = { 0 };
+    fwrite(padding, 1, header.history_offset - header.text_offset - text_bytes, fp);
+    for (HistoryEntry* h = history ? history->oldest : NULL; h; h = h->next) {
+        ProfileHistory record = { string_index[h->url] - 1, h->visits, h->last_visit };
+        fwrite(&record, sizeof(record), 1, fp);
+    }
+    for (uint32_t i = 0; i < bookmark_count; i++) {
+        uint32_t index = string_index[bookmarks[i]->url] - 1;
+        fwrite(&index, sizeof(index), 1, fp);
+    }
+    fwrite(padding, 1, header.recent_offset - header.bookmark_offset - (uint64_t)bookmark_count * sizeof(uint32_t), fp);
+    for (uint32_t i = 0; i < recent_count; i++) {
+        VisitEvent* event = &history->recent[(history->recent_first + i) % HISTORY_RECENT_VISITS];
+        ProfileVisit record = { string_index[event->url] - 1, 0, event->time };
+        fwrite(&record, sizeof(record), 1, fp);
+    }
+    fflush(fp);
+    fsync(fileno(fp));
+    if (!ferror(fp)) records = (long)history_count + (long)bookmark_count;
+    STAT_ADD(profile_bytes, (unsigned long long)ftell(fp));
+
+done:
+    if (fp && fclose(fp) != 0) records = -1;
+    free(string_index);
+    free(strings);
+    free(bookmarks);
+    return records;
+}
+
+void saveData(HistoryList* history, BookmarkNode* root) {
+    unsigned long long start = STAT_START();
+    TRACE_BEGIN("saveData");
+    TRACE_BEGIN("writeProfile");
+    long records = writeProfile(PROFILE_FILE ".tmp", history, root, journal.epoch + 1);
+    TRACE_END("writeProfile");
+    #ifdef _WIN32
+        if (records >= 0) remove(PROFILE_FILE);
+    #endif
+    if (records < 0 || rename(PROFILE_FILE ".tmp", PROFILE_FILE) != 0) {
+        uiPrintf(ANSI_COLOR_RED "Failed to save data!\n" ANSI_COLOR_RESET);
+        STAT_STOP(STAT_SAVE, start);
+        TRACE_END("saveData");
+        return;
+    }
+
+    // The new snapshot is in place; start an empty journal for its epoch.
+    journal.epoch++;
+    journal.snapshot_records = records;
+    journal.records = 0;
+    journal.pending = 0;
+    int was_open = journal.fp != NULL;
+    if (journal.fp) fclose(journal.fp);
+    journal.fp = fopen(JOURNAL_FILE, "w");
+    if (journal.fp) {
+        int written = fprintf(journal.fp, "E:%ld\n", journal.epoch);
+        if (written > 0) STAT_ADD(journal_bytes, (unsigned long long)written);
+        fflush(journal.fp);
+        fsync(fileno(journal.fp));
+        if (!was_open) {
+            fclose(journal.fp);
+            journal.fp = NULL;
+        }
+    }
+    STAT_STOP(STAT_SAVE, start);
+    TRACE_END("saveData");
+}
+
+// Maps a whole file read-only. The mapping is kept for the rest of the
+// session because interned URLs point straight into it. On Windows the
+// file is read into memory instead, so compaction can still replace it.
+const char* mapProfile(const char* path, size_t* size) {
+    #ifdef _WIN32
+        FILE* fp = fopen(path, "rb");
+        if (!fp) return NULL;
+        fseek(fp, 0, SEEK_END);
+        long length = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        char* data = length > 0 ? (char*)malloc(length) : NULL;
+        if (!data || fread(data, 1, length, fp) != (size_t)length) {
+            free(data);
+            fclose(fp);
+            return NULL;
+        }
+        fclose(fp);
+        *size = (size_t)length;
+        return data;
+    #else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return NULL;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            close(fd);
+            return NULL;
+        }
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) return NULL;
+        *size = (size_t)st.st_size;
+        return (const char*)data;
+    #endif
+}
+
+// Releases a profile that was rejected before anything pointed into it.
+void unmapProfile(const char* data, size_t size) {
+    #ifdef _WIN32
+        (void)size;
+        free((void*)data);
+    #else
+        munmap((void*)data, size);
+    #endif
+}
+
+// Whether count records of record_size bytes starting at offset end at or
+// before end; each term is checked on its own so nothing can wrap.
+int profileRangeFits(uint64_t offset, uint64_t count, uint64_t record_size, uint64_t end) {
+    return offset <= end && count <= (end - offset) / record_size;
+}
+
+// Builds a balanced bookmark tree from ids already in URL order.
+BookmarkNode* buildBookmarks(const UrlId* ids, int count) {
+    if (count <= 0) return NULL;
+    int mid = count / 2;
+    BookmarkNode* node = (BookmarkNode*)poolAlloc(&bookmark_pool);
+    if (!node) return NULL;
+    node->url = ids[mid];
+    node->left = buildBookmarks(ids, mid);
+    node->right = buildBookmarks(ids + mid + 1, count - mid - 1);
+    updateBookmarkNode(node);
+    return node;
+}
+
+// Loads a binary profile without parsing or copying its strings: they are
+// interned in place, with the hashes stored in the file. Returns the number
+// of records loaded, or -1 if the file is missing or malformed.
+long loadProfile(const char* path, HistoryList* history, BookmarkNode** root, long* epoch) {
+    size_t size = 0;
+    const char* data = mapProfile(path, &size);
+    if (!data) return -1;
+    const ProfileHeader* header = (const ProfileHeader*)data;
+    int legacy = size >= PROFILE_V1_HEADER_SIZE && header->version == 1 &&
+                 header->header_size == PROFILE_V1_HEADER_SIZE;
+    int current = size >= sizeof(ProfileHeader) && header->version == PROFILE_VERSION &&
+                  header->header_size == sizeof(ProfileHeader);
+    if (!(legacy || current) || memcmp(header->magic, PROFILE_MAGIC, sizeof(header->magic)) != 0 ||
+        !profileRangeFits(header->strings_offset, header->string_count, sizeof(ProfileString), header->text_offset) ||
+        !profileRangeFits(header->text_offset, header->text_bytes, 1, header->history_offset) ||
+        !profileRangeFits(header->history_offset, header->history_count,
+                          legacy ? sizeof(uint32_t) : sizeof(ProfileHistory), header->bookmark_offset) ||
+        !profileRangeFits(header->bookmark_offset, header->bookmark_count, sizeof(uint32_t), size) ||
+        (current && (!profileRangeFits(header->bookmark_offset, header->bookmark_count, sizeof(uint32_t),
+                                       header->recent_offset) ||
+                     !profileRangeFits(header->recent_offset, header->recent_count, sizeof(ProfileVisit), size)))) {
+        uiPrintf(ANSI_COLOR_RED "Ignoring malformed profile %s\n" ANSI_COLOR_RESET, path);
+        unmapProfile(data, size);
+        return -1;
+    }
+
+    const ProfileString* strings = (const ProfileString*)(data + header->strings_offset);
+    const char* text = data + header->text_offset;
+    // The intern table and the cache trust a URL's hash, so a string whose
+    // stored hash or length does not match its text rejects the profile,
+    // before any string points into the mapping.
+    for (uint32_t i = 0; i < header->string_count; i++) {
+        const ProfileString* s = &strings[i];
+        if (s->offset >= header->text_bytes || s->length >= header->text_bytes - s->offset ||
+            text[s->offset + s->length] != '\0') {
+            continue;
+        }
+        if (strlen(text + s->offset) != s->length || hashURL(text + s->offset) != s->hash) {
+            uiPrintf(ANSI_COLOR_RED "Ignoring malformed profile %s\n" ANSI_COLOR_RESET, path);
+            unmapProfile(data, size);
+            return -1;
+        }
+    }
+    UrlId* ids = (UrlId*)malloc(((size_t)header->string_count + 1) * sizeof(UrlId));
+    if (!ids) {
+        unmapProfile(data, size);
+        return -1;
+    }
+    for (uint32_t i = 0; i < header->string_count; i++) {
+        const ProfileString* s = &strings[i];
+        if (s->offset >= header->text_bytes || s->length >= header->text_bytes - s->offset ||
+            text[s->offset + s->length] != '\0') {
+            ids[i] = NO_URL;
+            continue;
+        }
+        ids[i] = url_table.count == 0 ? NO_URL : findURL(text + s->offset);
+        if (ids[i] == NO_URL) ids[i] = addInternedURL(text + s->offset, s->length, s->hash);
+    }
+
+    if (legacy) {
+        // Version 1 kept every visit, undated; they count as made now.
+        const uint32_t* visits = (const uint32_t*)(data + header->history_offset);
+        long long now = (long long)time(NULL);
+        for (uint32_t i = 0; i < header->history_count; i++) {
+            if (visits[i] < header->string_count && ids[visits[i]] != NO_URL) {
+                appendHistory(history, ids[visits[i]], now);
+            }
+        }
+    } else {
+        const ProfileHistory* entries = (const ProfileHistory*)(data + header->history_offset);
+        for (uint32_t i = 0; i < header->history_count; i++) {
+            const ProfileHistory* e = &entries[i];
+            if (e->string < header->string_count && ids[e->string] != NO_URL) {
+                touchHistoryEntry(history, ids[e->string], e->visits ? e->visits : 1, e->last_visit);
+            }
+        }
+        const ProfileVisit* recent = (const ProfileVisit*)(data + header->recent_offset);
+        for (uint32_t i = 0; i < header->recent_count; i++) {
+            if (recent[i].string < header->string_count && ids[recent[i].string] != NO_URL) {
+                pushRecentVisit(history, ids[recent[i].string], recent[i].time);
+            }
+        }
+    }
+
+    const uint32_t* marks = (const uint32_t*)(data + header->bookmark_offset);
+    UrlId* sorted = (UrlId*)malloc(((size_t)header->bookmark_count + 1) * sizeof(UrlId));
+    int sorted_count = 0;
+    for (uint32_t i = 0; sorted && i < header->bookmark_count; i++) {
+        if (marks[i] < header->string_count && ids[marks[i]] != NO_URL) {
+            sorted[sorted_count++] = ids[marks[i]];
+        }
+    }
+    if (sorted && !*root) {
+        *root = buildBookmarks(sorted, sorted_count);
+    } else {
+        for (int i = 0; sorted && i < sorted_count; i++) {
+            *root = insertBookmark(*root, urlText(sorted[i]));
+        }
+    }
+    free(sorted);
+    free(ids);
+    *epoch = header->epoch;
+    return (long)header->history_count + (long)header->bookmark_count;
+}
+
+// Reads one "X:value" line of any length into *line, growing the buffer
+// as needed. The caller frees *line.
+int readRecord(FILE* fp, char** line, size_t* size) {
+    size_t len = 0;
+    while (1) {
+        if (len + 1 >= *size) {
+            size_t grown = *size ? *size * 2 : 256;
+            char* buffer = (char*)realloc(*line, grown);
+            if (!buffer) return 0;
+            *line = buffer;
+            *size = grown;
+        }
+        if (!fgets(*line + len, (int)(*size - len), fp)) {
+            (*line)[len] = '\0';
+            return len > 0;
+        }
+        len += strlen(*line + len);
+        if ((*line)[len - 1] == '\n') {
+            (*line)[len - 1] = '\0';
+            return 1;
+        }
+    }
+}
+
+// Replays the records of a text snapshot or journal in one buffered pass.
+// A snapshot stores its epoch in *epoch; a journal whose epoch differs from
+// *epoch is stale and ignored. Visits are "V:time:url"; older "H:url"
+// visits carry no time and count as made now. Returns the number of
+// records, -1 if the file does not exist, or -2 for a stale journal.
+long replayTextFile(const char* path, HistoryList* history, BookmarkNode** root, long* epoch, int is_journal) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    setvbuf(fp, NULL, _IOFBF, LOAD_BUFFER);
+    char* line = NULL;
+    size_t size = 0;
+    long records = 0;
+    long long now = (long long)time(NULL);
+    while (readRecord(fp, &line, &size)) {
+        if (line[0] == 'E') {
+            long file_epoch = atol(line + 2);
+            if (!is_journal) {
+                *epoch = file_epoch;
+            } else if (file_epoch != *epoch) {
+                records = -2;
+                break;
+            }
+        } else if (line[0] == 'V') {
+            char* url;
+            long long when = strtoll(line + 2, &url, 10);
+            if (*url == ':') {
+                appendHistory(history, internURL(url + 1), when);
+                records++;
+            }
+        } else if (line[0] == 'H') {
+            appendHistory(history, internURL(line + 2), now);
+            records++;
+        } else if (line[0] == 'B') {
+            *root = insertBookmark(*root, line + 2);
+            records++;
+        } else if (line[0] == 'X') {
+            char* to;
+            long long from = strtoll(line + 2, &to, 10);
+            if (*to == ':') {
+                deleteHistoryRange(history, from, strtoll(to + 1, NULL, 10));
+                records++;
+            }
+        } else if (line[0] == 'C') {
+            freeHistory(history);
+            records++;
+        }
+    }
+    free(line);
+    fclose(fp);
+    return records;
+}
+
+// Bulk loader: the snapshot, then the journal, each in a single pass.
+// Entries are linked straight into the history list and bookmark tree, so
+// nothing is written back while loading.
+void loadData(HistoryList* history, BookmarkNode** root) {
+    double start = nowMs();
+    long epoch = 0;
+    long records = loadProfile(PROFILE_FILE, history, root, &epoch);
+    if (records < 0) records = replayTextFile(DATA_FILE, history, root, &epoch, 0);
+    journal.snapshot_records = records < 0 ? 0 : records;
+    long replayed = replayTextFile(JOURNAL_FILE, history, root, &epoch, 1);
+    journal.records = replayed < 0 ? 0 : replayed;
+    journal.stale = replayed == -2;
+    journal.epoch = epoch;
+    load_stats.history_records = history->size;
+    load_stats.bookmark_records = bookmarkCount(*root);
+    load_stats.millis = nowMs() - start;
+}
+
+// Converts a text profile to the binary format, then loads the result
+// back and checks that history and bookmarks match entry for entry.
+int convertProfile(const char* text_path, const char* profile_path) {
+    HistoryList history;
+    BookmarkNode* root = initBookmarks();
+    initHistory(&history);
+    long epoch = 0;
+    if (replayTextFile(text_path, &history, &root, &epoch, 0) < 0) {
+        printf(ANSI_COLOR_RED "Cannot read %s\n" ANSI_COLOR_RESET, text_path);
+        return 1;
+    }
+    double start = nowMs();
+    long records = writeProfile(profile_path, &history, root, epoch);
+    double write_ms = nowMs() - start;
+    if (records < 0) {
+        printf(ANSI_COLOR_RED "Cannot write %s\n" ANSI_COLOR_RESET, profile_path);
+        return 1;
+    }
+
+    HistoryList loaded;
+    BookmarkNode* loaded_root = NULL;
+    initHistory(&loaded);
+    long loaded_epoch = -1;
+    start = nowMs();
+    long loaded_records = loadProfile(profile_path, &loaded, &loaded_root, &loaded_epoch);
+    double load_ms = nowMs() - start;
+    int ok = loaded_records == records && loaded_epoch == epoch &&
+             loaded.size == history.size && loaded.recent_count == history.recent_count &&
+             bookmarkCount(loaded_root) == bookmarkCount(root);
+    for (HistoryEntry *a = history.oldest, *b = loaded.oldest; ok && a; a = a->next, b = b->next) {
+        ok = a->url == b->url && a->visits == b->visits && a->last_visit == b->last_visit;
+    }
+    for (int i = 0; ok && i < bookmarkCount(root); i++) {
+        ok = bookmarkAt(root, i)->url == bookmarkAt(loaded_root, i)->url;
+    }
+    printf("Converted %d history entries and %d bookmarks from %s to %s\n",
+           history.size, bookmarkCount(root), text_path, profile_path);
+    printf("Write: %.2f ms, load: %.2f ms, round-trip check %s\n",
+           write_ms, load_ms, ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+// Journal
+// A stale journal left by an interrupted compaction is truncated here, so
+// new records are not appended under another epoch's header and dropped
+// on the next load.
+void openJournal() {
+    if (journal.fp) return;
+    journal.fp = fopen(JOURNAL_FILE, journal.stale ? "w" : "a");
+    journal.stale = 0;
+    if (!journal.fp) {
+        uiPrintf(ANSI_COLOR_RED "Failed to open %s, changes will not be saved!\n" ANSI_COLOR_RESET, JOURNAL_FILE);
+        return;
+    }
+    if (ftell(journal.fp) == 0) {
+        fprintf(journal.fp, "E:%ld\n", journal.epoch);
+    }
+}
+
+// Appends one record, formatted as one line. Records are written through
+// the stdio buffer and fsync'd in groups of JOURNAL_BATCH, or once the
+// oldest unsynced record is JOURNAL_FLUSH_SECS old; journalSync() forces
+// the group out.
+void journalRecord(const char* format, ...) {
+    if (!journal.fp) return; // nothing to record while loading
+    va_list args;
+    va_start(args, format);
+    int written = vfprintf(journal.fp, format, args);
+    va_end(args);
+    if (written > 0) STAT_ADD(journal_bytes, (unsigned long long)written);
+    journal.records++;
+    time_t now = time(NULL);
+    if (journal.pending++ == 0) {
+        journal.oldest_pending = now;
+    }
+    if (journal.pending >= JOURNAL_BATCH || now - journal.oldest_pending >= JOURNAL_FLUSH_SECS) {
+        journalSync();
+    }
+}
+
+void journalAppend(char type, const char* url) {
+    journalRecord("%c:%s\n", type, url);
+}
+
+void journalVisit(const char* url, long long when) {
+    journalRecord("V:%lld:%s\n", when, url);
+}
+
+void journalSync() {
+    if (!journal.fp || journal.pending == 0) return;
+    TRACE_BEGIN("journal fsync");
+    fflush(journal.fp);
+    fsync(fileno(journal.fp));
+    journal.pending = 0;
+    TRACE_END("journal fsync");
+}
+
+// Folds the journal back into a fresh snapshot once it has grown as large
+// as the snapshot itself, so rewrite cost stays amortized O(1) per record,
+// or when retention dropped history entries, so the files shrink with
+// memory. Called between menu actions, never on the navigation path.
+void compactData(HistoryList* history, BookmarkNode* root) {
+    int pruned = pruneHistory(history, (long long)time(NULL)) > 0;
+    if (!pruned && (journal.records < COMPACT_MIN_RECORDS || journal.records < journal.snapshot_records)) return;
+    journalSync();
+    saveData(history, root);
+}
+
+// External Browser Launcher
+// openURLInBrowser() only queues the URL. The queue is flushed at the idle
+// point of the main loop, so a burst of opens from one action becomes a
+// single launcher process. On POSIX the launcher is started with
+// posix_spawnp (no shell) with its output sent to /dev/null, and its pid
+// is polled at later idle points, so the UI never waits on the browser.
+// Only pids spawned here are reaped; other children keep their exit
+// status for whoever waits on them. --launcher or SURF_LAUNCHER replaces
+// the browser command; queued URLs are appended as arguments.
+#ifndef _WIN32
+void reapLaunchers() {
+    int kept = 0;
+    for (int i = 0; i < launcher.child_count; i++) {
+        pid_t pid = (pid_t)launcher.children[i];
+        if (waitpid(pid, NULL, WNOHANG) == 0) launcher.children[kept++] = (int)pid;
+    }
+    launcher.child_count = kept;
+}
+#endif
+
+// command is split on whitespace; NULL or empty keeps the browser default.
+void initLauncher(const char* command) {
+    if (command && *command) {
+        launcher.command = (char*)malloc(strlen(command) + 1);
+        if (launcher.command) {
+            strcpy(launcher.command, command);
+            for (char* word = strtok(launcher.command, " \t"); word && launcher.argc < LAUNCH_MAX_ARGS;
+                 word = strtok(NULL, " \t")) {
+                launcher.argv[launcher.argc++] = word;
+            }
         }
     }
-    fclose(fp);
 }
 
-// Open URL in external browser
 void openURLInBrowser(const char* url) {
-    char command[URL_LEN + 50];
-    char formatted_url[URL_LEN];
-    
+    unsigned long long start = STAT_START();
+    TRACE_BEGIN("openURLInBrowser");
+    char formatted_url[MAX_URL_LEN + 8];
+
     if (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) {
-        snprintf(formatted_url, URL_LEN, "https://%s", url);
+        snprintf(formatted_url, sizeof(formatted_url), "https://%s", url);
     } else {
-        strncpy(formatted_url, url, URL_LEN - 1);
-        formatted_url[URL_LEN - 1] = '\0';
+        snprintf(formatted_url, sizeof(formatted_url), "%s", url);
+    }
+
+    for (int i = 0; i < launcher.pending_count; i++) {
+        if (strcmp(launcher.pending[i], formatted_url) == 0) {
+            launcher.coalesced++;
+            STAT_STOP(STAT_OPEN, start);
+            TRACE_END("openURLInBrowser");
+            return;
+        }
+    }
+    if (launcher.pending_count == LAUNCH_BATCH_MAX) flushLaunches();
+    char* copy = (char*)malloc(strlen(formatted_url) + 1);
+    if (copy) {
+        strcpy(copy, formatted_url);
+        launcher.pending[launcher.pending_count++] = copy;
+    }
+    STAT_STOP(STAT_OPEN, start);
+    TRACE_END("openURLInBrowser");
+}
+
+#ifndef _WIN32
+// Starts argv[0] from PATH without a shell. Returns 0 on success.
+int spawnLauncher(char* const argv[]) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    pid_t pid;
+    if (launcher.child_count == LAUNCH_MAX_CHILDREN) {
+        waitpid((pid_t)launcher.children[0], NULL, 0);
+        memmove(launcher.children, launcher.children + 1, (LAUNCH_MAX_CHILDREN - 1) * sizeof(int));
+        launcher.child_count--;
     }
+    TRACE_BEGIN("posix_spawnp");
+    int status = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    TRACE_END("posix_spawnp");
+    posix_spawn_file_actions_destroy(&actions);
+    if (status != 0) {
+        launcher.failures++;
+        return status;
+    }
+    launcher.children[launcher.child_count++] = (int)pid;
+    launcher.launches++;
+    return 0;
+}
+#endif
 
+// Launches everything queued since the last flush.
+void flushLaunches() {
+    #ifndef _WIN32
+        if (launcher.child_count > 0) reapLaunchers();
+    #endif
+    if (launcher.pending_count == 0) return;
+    unsigned long long start = STAT_START();
+    TRACE_BEGIN("flushLaunches");
+    launcher.urls += launcher.pending_count;
     #ifdef _WIN32
-        if (browser_choice == 1) {
-            snprintf(command, sizeof(command), "start msedge \"%s\"", formatted_url);
-        } else if (browser_choice == 2) {
-            snprintf(command, sizeof(command), "start chrome \"%s\"", formatted_url);
-        } else {
-            snprintf(command, sizeof(command), "start \"\" \"%s\"", formatted_url);
+        char command[MAX_URL_LEN + 64];
+        for (int i = 0; i < launcher.pending_count; i++) {
+            const char* formatted_url = launcher.pending[i];
+            if (launcher.argc > 0) {
+                snprintf(command, sizeof(command), "start \"\" %s \"%s\"", launcher.command, formatted_url);
+            } else if (browser_choice == 1) {
+                snprintf(command, sizeof(command), "start msedge \"%s\"", formatted_url);
+            } else if (browser_choice == 2) {
+                snprintf(command, sizeof(command), "start chrome \"%s\"", formatted_url);
+            } else {
+                snprintf(command, sizeof(command), "start \"\" \"%s\"", formatted_url);
+            }
+            TRACE_BEGIN("system");
+            system(command);
+            TRACE_END("system");
+            launcher.launches++;
         }
-    #elif __APPLE__
-        if (browser_choice == 1) {
-            snprintf(command, sizeof(command), "open -a \"Microsoft Edge\" \"%s\"", formatted_url);
-        } else if (browser_choice == 2) {
-            snprintf(command, sizeof(command), "open -a \"Google Chrome\" \"%s\"", formatted_url);
+    #else
+        char* argv[LAUNCH_MAX_ARGS + LAUNCH_BATCH_MAX + 4];
+        int argc = 0;
+        int single = 0; // launcher takes one URL per invocation
+        if (launcher.argc > 0) {
+            for (int i = 0; i < launcher.argc; i++) argv[argc++] = launcher.argv[i];
         } else {
-            snprintf(command, sizeof(command), "open \"%s\"", formatted_url);
+            #ifdef __APPLE__
+                argv[argc++] = "open";
+                if (browser_choice == 1) {
+                    argv[argc++] = "-a";
+                    argv[argc++] = "Microsoft Edge";
+                } else if (browser_choice == 2) {
+                    argv[argc++] = "-a";
+                    argv[argc++] = "Google Chrome";
+                }
+            #else
+                if (browser_choice == 1) {
+                    argv[argc++] = "microsoft-edge";
+                } else if (browser_choice == 2) {
+                    argv[argc++] = "google-chrome";
+                } else {
+                    argv[argc++] = "xdg-open";
+                    single = 1;
+                }
+            #endif
         }
-    #else
-        if (browser_choice == 1) {
-            snprintf(command, sizeof(command), "microsoft-edge \"%s\"", formatted_url);
-        } else if (browser_choice == 2) {
-            snprintf(command, sizeof(command), "google-chrome \"%s\"", formatted_url);
+        if (single) {
+            for (int i = 0; i < launcher.pending_count; i++) {
+                argv[argc] = launcher.pending[i];
+                argv[argc + 1] = NULL;
+                spawnLauncher(argv);
+            }
         } else {
-            snprintf(command, sizeof(command), "xdg-open \"%s\"", formatted_url);
+            for (int i = 0; i < launcher.pending_count; i++) argv[argc++] = launcher.pending[i];
+            argv[argc] = NULL;
+            spawnLauncher(argv);
         }
     #endif
+    for (int i = 0; i < launcher.pending_count; i++) free(launcher.pending[i]);
+    launcher.pending_count = 0;
+    STAT_STOP(STAT_LAUNCH, start);
+    TRACE_END("flushLaunches");
+}
+
+// HTTP Client
+// Plain HTTP/1.1 for http:// URLs (https:// and bare names keep the
+// simulated pages). Connections are kept alive and pooled per host:port;
+// a pooled connection the server has closed is detected before reuse, and
+// a request that fails on a reused connection before any response bytes
+// arrive is retried once on a fresh one. Connect, send and every read wait
+// at most http.timeout_ms. Bodies with Content-Length, chunked encoding or
+// read-until-close framing are streamed through a fixed buffer; the first
+// bytes fill the page and the rest are counted and discarded.
+#ifndef _WIN32
+void initHttpClient() {
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) http.pool[i].fd = -1;
+    http.timeout_ms = HTTP_TIMEOUT_MS;
+    http.keep_alive = 1;
+    pthread_mutex_init(&http.lock, NULL);
+    signal(SIGPIPE, SIG_IGN);
+}
+
+// Splits http://host[:port][/path]. Returns 0 for anything else.
+int parseHttpURL(const char* url, char* host, int* port, char* path, size_t path_size) {
+    if (strncmp(url, "http://", 7) != 0) return 0;
+    const char* start = url + 7;
+    size_t length = strcspn(start, ":/?");
+    if (length == 0 || length >= HTTP_HOST_LEN) return 0;
+    memcpy(host, start, length);
+    host[length] = '\0';
+    const char* rest = start + length;
+    *port = 80;
+    if (*rest == ':') {
+        char* end;
+        long value = strtol(rest + 1, &end, 10);
+        if (end == rest + 1 || value <= 0 || value > 65535) return 0;
+        *port = (int)value;
+        rest = end;
+    }
+    if (*rest == '/') snprintf(path, path_size, "%s", rest);
+    else snprintf(path, path_size, "/%s", rest);
+    return 1;
+}
+
+// Waits until fd is ready for events; 0 on timeout or error.
+int httpWait(int fd, short events) {
+    struct pollfd pfd = { fd, events, 0 };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, http.timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    return ready > 0;
+}
+
+int httpConnect(const char* host, int port) {
+    struct addrinfo hints, *addresses = NULL;
+    char service[16];
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+    if (getaddrinfo(host, service, &hints, &addresses) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) continue;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int connected = connect(fd, address->ai_addr, address->ai_addrlen) == 0;
+        if (!connected && errno == EINPROGRESS && httpWait(fd, POLLOUT)) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            connected = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+        }
+        if (!connected) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        __atomic_fetch_add(&http.connects, 1, __ATOMIC_RELAXED);
+    }
+    return fd;
+}
+
+// Takes an idle pooled connection to host:port, skipping ones the server
+// has closed meanwhile (an idle keep-alive socket is never readable).
+int httpAcquire(const char* host, int port) {
+    int fd = -1;
+    pthread_mutex_lock(&http.lock);
+    for (int i = 0; i < HTTP_POOL_SIZE && fd < 0; i++) {
+        HttpConnection* connection = &http.pool[i];
+        if (connection->fd < 0 || connection->port != port || strcmp(connection->host, host) != 0) continue;
+        fd = connection->fd;
+        connection->fd = -1;
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 0) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    pthread_mutex_unlock(&http.lock);
+    return fd;
+}
+
+// Returns a connection to the pool, replacing the least recently used.
+void httpRelease(const char* host, int port, int fd) {
+    pthread_mutex_lock(&http.lock);
+    HttpConnection* slot = &http.pool[0];
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (http.pool[i].fd < 0) {
+            slot = &http.pool[i];
+            break;
+        }
+        if (http.pool[i].last_used < slot->last_used) slot = &http.pool[i];
+    }
+    if (slot->fd >= 0) close(slot->fd);
+    snprintf(slot->host, sizeof(slot->host), "%s", host);
+    slot->port = port;
+    slot->fd = fd;
+    slot->last_used = nowMs();
+    pthread_mutex_unlock(&http.lock);
+}
+
+void closeHttpConnections() {
+    pthread_mutex_lock(&http.lock);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (http.pool[i].fd >= 0) close(http.pool[i].fd);
+        http.pool[i].fd = -1;
+    }
+    pthread_mutex_unlock(&http.lock);
+}
+
+int httpSendAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, 0);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (!httpWait(fd, POLLOUT)) return 0;
+            continue;
+        }
+        if (sent <= 0) return 0;
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 1;
+}
+
+// Refills the reader's buffer. Returns bytes read, 0 at EOF, -1 on error
+// or timeout.
+long httpFill(HttpReader* reader) {
+    reader->pos = 0;
+    reader->length = 0;
+    while (1) {
+        ssize_t got = recv(reader->fd, reader->buffer, sizeof(reader->buffer), 0);
+        if (got >= 0) {
+            reader->length = (size_t)got;
+            reader->received += (size_t)got;
+            __atomic_fetch_add(&http.bytes, (unsigned long long)got, __ATOMIC_RELAXED);
+            return (long)got;
+        }
+        if (errno == EINTR) continue;
+        if ((errno != EAGAIN && errno != EWOULDBLOCK) || !httpWait(reader->fd, POLLIN)) return -1;
+    }
+}
+
+// Reads one CRLF-terminated line without the line ending.
+int httpReadLine(HttpReader* reader, char* line, size_t size) {
+    size_t length = 0;
+    while (1) {
+        if (reader->pos == reader->length && httpFill(reader) <= 0) return 0;
+        char c = reader->buffer[reader->pos++];
+        if (c == '\n') break;
+        if (length + 1 < size) line[length++] = c;
+    }
+    if (length > 0 && line[length - 1] == '\r') length--;
+    line[length] = '\0';
+    return 1;
+}
+
+// Streams up to count body bytes (-1: until EOF) into the page buffer.
+int httpReadBody(HttpReader* reader, long long count, HttpBody* body) {
+    while (count != 0) {
+        if (reader->pos == reader->length) {
+            long got = httpFill(reader);
+            if (got < 0) return 0;
+            if (got == 0) return count < 0;
+        }
+        size_t available = reader->length - reader->pos;
+        if (count > 0 && (long long)available > count) available = (size_t)count;
+        Page* page = body->page;
+        if (page->length < body->limit) {
+            size_t room = body->limit - page->length;
+            size_t copy = available < room ? available : room;
+            if (pageReserve(page, page->length + copy)) {
+                memcpy(page->text + page->length, reader->buffer + reader->pos, copy);
+                page->length += copy;
+                page->text[page->length] = '\0';
+            }
+        }
+        body->total += available;
+        reader->pos += available;
+        if (count > 0) count -= (long long)available;
+    }
+    return 1;
+}
+
+// Sends one request on fd and reads the response. Returns the status code,
+// or -1 if the connection failed; *reusable says whether fd can be pooled.
+int httpExchange(int fd, const char* request, size_t request_length, HttpBody* body, int* reusable, int* got_bytes) {
+    HttpReader reader;
+    reader.fd = fd;
+    reader.pos = reader.length = 0;
+    reader.received = 0;
+    *reusable = 0;
+    *got_bytes = 0;
+    if (!httpSendAll(fd, request, request_length)) return -1;
+
+    char line[HTTP_LINE_LEN];
+    int status = 0, minor = 0;
+    do { // skip interim 1xx responses
+        if (!httpReadLine(&reader, line, sizeof(line))) {
+            *got_bytes = reader.received > 0;
+            return -1;
+        }
+        *got_bytes = 1;
+        if (sscanf(line, "HTTP/1.%d %d", &minor, &status) != 2) return -1;
+        if (status < 200) {
+            while (httpReadLine(&reader, line, sizeof(line)) && line[0]) {}
+        }
+    } while (status < 200);
+
+    long long content_length = -1;
+    int chunked = 0, keep_alive = minor >= 1;
+    while (1) {
+        if (!httpReadLine(&reader, line, sizeof(line))) return -1;
+        if (!line[0]) break;
+        char* value = strchr(line, ':');
+        if (!value) continue;
+        *value++ = '\0';
+        value += strspn(value, " \t");
+        if (strcasecmp(line, "Content-Length") == 0) {
+            content_length = atoll(value);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+            chunked = strstr(value, "chunked") != NULL;
+        } else if (strcasecmp(line, "Connection") == 0) {
+            if (strcasecmp(value, "close") == 0) keep_alive = 0;
+            else if (strcasecmp(value, "keep-alive") == 0) keep_alive = 1;
+        }
+    }
+
+    int ok;
+    if (status == 204 || status == 304) {
+        ok = 1;
+    } else if (chunked) {
+        ok = 1;
+        while (ok) {
+            if (!httpReadLine(&reader, line, sizeof(line))) return -1;
+            // hex size, optionally followed by ";extensions"; anything
+            // else is a corrupt stream, not the last chunk
+            char* end;
+            long long size = strtoll(line, &end, 16);
+            while (*end == ' ' || *end == '\t') end++;
+            if (end == line || !isxdigit((unsigned char)line[0]) || size < 0 || (*end && *end != ';')) return -1;
+            if (size == 0) {
+                while ((ok = httpReadLine(&reader, line, sizeof(line))) && line[0]) {} // trailers
+                break;
+            }
+            ok = httpReadBody(&reader, size, body) && httpReadLine(&reader, line, sizeof(line));
+        }
+    } else if (content_length >= 0) {
+        ok = httpReadBody(&reader, content_length, body);
+    } else {
+        ok = httpReadBody(&reader, -1, body);
+        keep_alive = 0;
+    }
+    if (!ok) return -1;
+    *reusable = keep_alive && reader.pos == reader.length;
+    return status;
+}
+
+// Fetches url into page, keeping at most PAGE_MAX_LEN bytes of the body.
+// Returns the HTTP status, or -1 with an error message in page.
+int httpFetch(const char* url, Page* page) {
+    char host[HTTP_HOST_LEN], path[MAX_URL_LEN];
+    int port;
+    if (!parseHttpURL(url, host, &port, path, sizeof(path))) {
+        pagePrintf(page, "Not an http:// URL");
+        return -1;
+    }
+    char request[MAX_URL_LEN + HTTP_HOST_LEN + 160];
+    int request_length = snprintf(request, sizeof(request),
+        "GET %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: SurfBrowser/4.1\r\nAccept: */*\r\nConnection: %s\r\n\r\n",
+        path, host, port, http.keep_alive ? "keep-alive" : "close");
+    if (request_length >= (int)sizeof(request)) {
+        pagePrintf(page, "URL too long");
+        return -1;
+    }
+    __atomic_fetch_add(&http.requests, 1, __ATOMIC_RELAXED);
+
+    HttpBody body = { page, PAGE_MAX_LEN, 0 };
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int fd = http.keep_alive ? httpAcquire(host, port) : -1;
+        int reused = fd >= 0;
+        if (!reused) fd = httpConnect(host, port);
+        if (fd < 0) {
+            __atomic_fetch_add(&http.failures, 1, __ATOMIC_RELAXED);
+            pagePrintf(page, "Cannot connect to %s:%d", host, port);
+            return -1;
+        }
+        if (reused) __atomic_fetch_add(&http.reuses, 1, __ATOMIC_RELAXED);
+        pageSet(page, "", 0);
+        body.total = 0;
+        int reusable, got_bytes;
+        int status = httpExchange(fd, request, (size_t)request_length, &body, &reusable, &got_bytes);
+        if (status > 0) {
+            if (reusable && http.keep_alive) httpRelease(host, port, fd);
+            else close(fd);
+            __atomic_fetch_add(&http.body_bytes, body.total, __ATOMIC_RELAXED);
+            return status;
+        }
+        close(fd);
+        // a pooled connection may have been closed by the server just now
+        if (!reused || got_bytes) break;
+        __atomic_fetch_add(&http.retries, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&http.failures, 1, __ATOMIC_RELAXED);
+    pagePrintf(page, "Connection to %s:%d failed or timed out", host, port);
+    return -1;
+}
+
+// Loopback HTTP Server
+// A single-threaded keep-alive server for trying the client against, run
+// with --serve PORT. Routes:
+//   /bytes/N    N-byte body with Content-Length
+//   /chunked/N  N-byte body in chunked encoding
+//   /close/N    N-byte body delimited by closing the connection
+//   /           a short index page
+int openHttpListener(int port, int* bound_port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)port);
+    socklen_t length = sizeof(address);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 64) != 0 ||
+        getsockname(fd, (struct sockaddr*)&address, &length) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (bound_port) *bound_port = ntohs(address.sin_port);
+    return fd;
+}
+
+// Writes a response for one request line. Returns 0 if the connection
+// should be closed afterwards.
+int serveHttpRequest(int fd, const char* request) {
+    char method[16], path[MAX_URL_LEN], header[256];
+    if (sscanf(request, "%15s %2047s", method, path) != 2) return 0;
+    int keep_alive = strstr(request, "Connection: close") == NULL;
+    long size = 0;
+    int mode = 0; // 0: Content-Length, 1: chunked, 2: close-delimited, 3: index, 4: 404
+    if (sscanf(path, "/bytes/%ld", &size) == 1) mode = 0;
+    else if (sscanf(path, "/chunked/%ld", &size) == 1) mode = 1;
+    else if (sscanf(path, "/close/%ld", &size) == 1) mode = 2;
+    else if (strcmp(path, "/") == 0) mode = 3;
+    else mode = 4;
+    if (size < 0) size = 0;
+
+    char body[HTTP_SERVE_BLOCK];
+    for (int i = 0; i < HTTP_SERVE_BLOCK; i++) body[i] = 'a' + i % 26;
+    for (int i = 63; i < HTTP_SERVE_BLOCK; i += 64) body[i] = '\n';
+    if (mode >= 3) {
+        const char* text = mode == 3
+            ? "| Surf loopback server                       |\n| Try /bytes/N, /chunked/N or /close/N       |\n"
+            : "| 404 Not Found on the loopback server       |\n";
+        int length = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Length: %zu\r\nContent-Type: text/plain\r\n%s\r\n",
+                              mode == 3 ? "200 OK" : "404 Not Found", strlen(text), keep_alive ? "" : "Connection: close\r\n");
+        return httpSendAll(fd, header, (size_t)length) && httpSendAll(fd, text, strlen(text)) && keep_alive;
+    }
+    int length;
+    if (mode == 0) {
+        length = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %ld\r\nContent-Type: text/plain\r\n%s\r\n",
+                          size, keep_alive ? "" : "Connection: close\r\n");
+    } else if (mode == 1) {
+        length = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nContent-Type: text/plain\r\n%s\r\n",
+                          keep_alive ? "" : "Connection: close\r\n");
+    } else {
+        keep_alive = 0;
+        length = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n");
+    }
+    if (!httpSendAll(fd, header, (size_t)length)) return 0;
+    for (long sent = 0; sent < size; ) {
+        long block = size - sent < HTTP_SERVE_BLOCK ? size - sent : HTTP_SERVE_BLOCK;
+        if (mode == 1) {
+            char chunk[32];
+            int chunk_length = snprintf(chunk, sizeof(chunk), "%lx\r\n", block);
+            if (!httpSendAll(fd, chunk, (size_t)chunk_length)) return 0;
+        }
+        if (!httpSendAll(fd, body, (size_t)block)) return 0;
+        if (mode == 1 && !httpSendAll(fd, "\r\n", 2)) return 0;
+        sent += block;
+    }
+    if (mode == 1 && !httpSendAll(fd, "0\r\n\r\n", 5)) return 0;
+    return keep_alive;
+}
+
+// Serves clients on listen_fd until the process is killed.
+void runHttpServer(int listen_fd) {
+    struct pollfd fds[HTTP_SERVE_CLIENTS + 1];
+    char* inputs[HTTP_SERVE_CLIENTS + 1];
+    size_t lengths[HTTP_SERVE_CLIENTS + 1];
+    int count = 1;
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    initHttpClient(); // send timeouts and SIGPIPE handling
+    while (1) {
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = accept(listen_fd, NULL, NULL);
+            char* input = client >= 0 && count <= HTTP_SERVE_CLIENTS ? (char*)malloc(HTTP_LINE_LEN * 4) : NULL;
+            if (input) {
+                int one = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                fcntl(client, F_SETFL, fcntl(client, F_GETFL, 0) | O_NONBLOCK);
+                fds[count].fd = client;
+                fds[count].events = POLLIN;
+                fds[count].revents = 0;
+                inputs[count] = input;
+                lengths[count] = 0;
+                count++;
+            } else if (client >= 0) {
+                close(client);
+            }
+        }
+        for (int i = 1; i < count; i++) {
+            if (!fds[i].revents) continue;
+            int open = 1;
+            ssize_t got = recv(fds[i].fd, inputs[i] + lengths[i], HTTP_LINE_LEN * 4 - 1 - lengths[i], 0);
+            if (got <= 0) {
+                open = got < 0 && (errno == EAGAIN || errno == EINTR);
+            } else {
+                lengths[i] += (size_t)got;
+                inputs[i][lengths[i]] = '\0';
+                char* end;
+                while (open && (end = strstr(inputs[i], "\r\n\r\n")) != NULL) {
+                    *end = '\0';
+                    open = serveHttpRequest(fds[i].fd, inputs[i]);
+                    size_t used = (size_t)(end + 4 - inputs[i]);
+                    memmove(inputs[i], end + 4, lengths[i] - used + 1);
+                    lengths[i] -= used;
+                }
+                if (lengths[i] >= HTTP_LINE_LEN * 4 - 1) open = 0;
+            }
+            if (!open) {
+                close(fds[i].fd);
+                free(inputs[i]);
+                count--;
+                fds[i] = fds[count];
+                inputs[i] = inputs[count];
+                lengths[i] = lengths[count];
+                i--;
+            }
+        }
+    }
+}
+
+int serveHttp(int port) {
+    int bound_port;
+    int fd = openHttpListener(port, &bound_port);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot listen on 127.0.0.1:%d\n", port);
+        return 1;
+    }
+    printf("Serving on http://127.0.0.1:%d/\n", bound_port);
+    fflush(stdout);
+    runHttpServer(fd);
+    return 0;
+}
+#else
+// Sockets are not wired up on Windows; http:// URLs keep the simulation.
+void initHttpClient() {
+    http.timeout_ms = HTTP_TIMEOUT_MS;
+}
+
+int httpFetch(const char* url, Page* page) {
+    (void)url;
+    pagePrintf(page, "HTTP is not available in the Windows build");
+    return -1;
+}
+
+void closeHttpConnections() {}
+
+int serveHttp(int port) {
+    (void)port;
+    fprintf(stderr, "--serve is not available in the Windows build\n");
+    return 1;
+}
+#endif
+
+// Builds the simulated page for url.
+void generatePage(const char* url, Page* page) {
+    if (strcmp(url, "home") == 0) {
+        pagePrintf(page, 
+            "| Welcome to Pranav's Surf Browser!          |\n"
+            "| Start your secure browsing journey.        |\n"
+            "| Powered by:                                |\n"
+            "| - Serverless CloudSync Architecture        |\n"
+            "| - Advanced Cybersecurity Suite             |\n"
+            "| - AI-Driven Threat Detection              |\n");
+    } else if (strcmp(url, "google.com") == 0) {
+        pagePrintf(page, 
+            "| Welcome to Google Search!                   |\n"
+            "| Search the world's information instantly.   |\n");
+    } else if (strcmp(url, "openai.com") == 0) {
+        pagePrintf(page, 
+            "| OpenAI - Pioneering AI Research            |\n"
+            "| Explore ChatGPT, Codex & more AI tools.    |\n");
+    } else {
+        pagePrintf(page, 
+            ANSI_COLOR_RED
+            "| 404 Not Found!                            |\n"
+            "| This is a simulated browser environment.   |\n"
+            ANSI_COLOR_RESET);
+    }
+}
 
-    system(command);
+// Builds the page for url, bypassing the cache: http:// URLs are fetched,
+// everything else is simulated. Returns 0 with an error page if the fetch
+// failed, and 0 with the server's page for a non-2xx status, so a
+// transient error is shown but never cached.
+int producePage(UrlId url, Page* page) {
+    const char* text = urlText(url);
+    page->stored = 0;
+    page->decode_us = 0;
+    if (strncmp(text, "http://", 7) != 0) {
+        generatePage(text, page);
+        return 1;
+    }
+    int status = httpFetch(text, page);
+    if (status >= 0) return status >= 200 && status < 300;
+    char error[512];
+    snprintf(error, sizeof(error), "%s", page->text ? page->text : "");
+    pagePrintf(page, ANSI_COLOR_RED "| Could not load page: %s\n" ANSI_COLOR_RESET, error);
+    return 0;
+}
+
+// Loads the page for url, from the cache when possible; failed fetches are
+// not cached. Returns 1 on a cache hit, 0 otherwise.
+int loadPage(HashTable* cache, UrlId url, Page* page) {
+    TRACE_BEGIN("loadPage");
+    int hit = cacheLookup(cache, url, page);
+    if (!hit && producePage(url, page)) storeInCache(cache, url, page, 0);
+    TRACE_END("loadPage");
+    return hit;
 }
 
 void fetchContent(HashTable* cache, const char* url) {
-    clearScreen();
+    unsigned long long start = STAT_START();
+    TRACE_BEGIN("fetchContent");
     showHeader();
+    uiRegion(REGION_BODY);
     
-    printf(ANSI_COLOR_GREEN);
-    printf("Current URL: %s\n", url);
-    printf(ANSI_COLOR_RESET);
+    uiPrintf(ANSI_COLOR_GREEN);
+    uiPrintf("Current URL: %s\n", url);
+    uiPrintf(ANSI_COLOR_RESET);
     
-    printf("%sCurrent Time: Fri May 23 23:10:00 IST 2025\n\n", TEXT_COLOR[theme]);
+    uiPrintf("%sCurrent Time: Fri May 23 23:10:00 IST 2025\n\n", TEXT_COLOR[theme]);
     
     if (strcmp(url, "home") != 0) {
         openURLInBrowser(url);
     }
     
-    printf("Web Content:\n");
-    printf("=============================================\n");
+    uiPrintf("Web Content:\n");
+    uiPrintf("=============================================\n");
     
-    char* cachedContent = getFromCache(cache, url);
-    if (cachedContent) {
-        printf("%s", cachedContent);
+    Page page = { NULL, 0, 0, 0, 0 };
+    int cached = loadPage(cache, internURL(url), &page);
+    if (!cached && strcmp(url, "home") == 0) {
+        showFakeFeatures(cache);
+    }
+    if (page.length > PAGE_VIEW_LEN) {
+        uiPrintf("%.*s\n%s... %zu more bytes\n", PAGE_VIEW_LEN, page.text, TEXT_COLOR[theme], page.length - PAGE_VIEW_LEN);
     } else {
-        char content[CONTENT_LEN] = "";
-        if (strcmp(url, "home") == 0) {
-            snprintf(content, CONTENT_LEN, 
-                "| Welcome to Pranav's Surf Browser!          |\n"
-                "| Start your secure browsing journey.        |\n"
-                "| Powered by:                                |\n"
-                "| - Serverless CloudSync Architecture        |\n"
-                "| - Advanced Cybersecurity Suite             |\n"
-                "| - AI-Driven Threat Detection              |\n");
-            showFakeFeatures();
-        } else if (strcmp(url, "google.com") == 0) {
-            snprintf(content, CONTENT_LEN, 
-                "| Welcome to Google Search!                   |\n"
-                "| Search the world's information instantly.   |\n");
-        } else if (strcmp(url, "openai.com") == 0) {
-            snprintf(content, CONTENT_LEN, 
-                "| OpenAI - Pioneering AI Research            |\n"
-                "| Explore ChatGPT, Codex & more AI tools.    |\n");
-        } else {
-            snprintf(content, CONTENT_LEN, 
-                ANSI_COLOR_RED
-                "| 404 Not Found!                            |\n"
-                "| This is a simulated browser environment.   |\n"
-                ANSI_COLOR_RESET);
-        }
-        printf("%s", content);
-        addToCache(cache, url, content);
+        uiPrintf("%s", page.text ? page.text : "");
     }
     
-    printf("=============================================\n\n");
+    uiPrintf("=============================================\n");
+    if (cached && page.length > 0) {
+        uiPrintf("%sCached: %zu bytes stored in %zu (%.0f%%), decoded in %.1f us\n",
+                 TEXT_COLOR[theme], page.length, page.stored, 100.0 * page.stored / page.length, page.decode_us);
+    }
+    uiPrintf("\n");
+    freePage(&page);
+    STAT_STOP(STAT_FETCH, start);
+    TRACE_END("fetchContent");
 }
 
 void showMenu() {
-    printf("%s", MENU_COLOR[theme]);
-    printf("Navigation Menu:\n");
-    printf("----------------------------\n");
-    printf("| [1] Enter New URL        |\n");
-    printf("| [2] Refresh Page         |\n");
-    printf("| [3] Go Back              |\n");
-    printf("| [4] Go Home              |\n");
-    printf("| [5] New Tab              |\n");
-    printf("| [6] Switch Tab           |\n");
-    printf("| [7] Set Browser          |\n");
-    printf("| [8] Clear History        |\n");
-    printf("| [9] Search History       |\n");
-    printf("| [10] Change Theme        |\n");
-    printf("| [11] Add Bookmark        |\n");
-    printf("| [12] View Bookmarks      |\n");
-    printf("| [13] Exit Browser        |\n");
-    printf("----------------------------\n");
-    printf("%sEnter choice (1-13): %s", TEXT_COLOR[theme], ANSI_COLOR_RESET);
+    uiRegion(REGION_MENU);
+    uiPrintf("%s", MENU_COLOR[theme]);
+    uiPrintf("Navigation Menu:\n");
+    uiPrintf("----------------------------\n");
+    uiPrintf("| [1] Enter New URL        |\n");
+    uiPrintf("| [2] Refresh Page         |\n");
+    uiPrintf("| [3] Go Back              |\n");
+    uiPrintf("| [4] Go Home              |\n");
+    uiPrintf("| [5] New Tab              |\n");
+    uiPrintf("| [6] Switch Tab           |\n");
+    uiPrintf("| [7] Set Browser          |\n");
+    uiPrintf("| [8] Clear History        |\n");
+    uiPrintf("| [9] Search History       |\n");
+    uiPrintf("| [10] Change Theme        |\n");
+    uiPrintf("| [11] Add Bookmark        |\n");
+    uiPrintf("| [12] View Bookmarks      |\n");
+    uiPrintf("| [13] Reload All Tabs     |\n");
+    uiPrintf("| [14] Go Forward          |\n");
+    uiPrintf("| [15] Statistics          |\n");
+    uiPrintf("| [16] Exit Browser        |\n");
+    uiPrintf("----------------------------\n");
+    uiPrintf("%sEnter choice (1-16): %s", TEXT_COLOR[theme], ANSI_COLOR_RESET);
 }
 
 int validateURL(const char* url) {
-    if (strlen(url) < 3 || strlen(url) >= URL_LEN) return 0;
+    if (strlen(url) < 3 || strlen(url) >= MAX_URL_LEN) return 0;
     for (int i = 0; url[i]; i++) {
         if (!isalnum(url[i]) && url[i] != '.' && url[i] != '-' && url[i] != '/' && url[i] != ':' && url[i] != '?' && url[i] != '&' && url[i] != '=') return 0;
     }
@@ -652,171 +5176,472 @@ int validateURL(const char* url) {
 }
 
 void suggestURLs(HistoryList* history, const char* prefix) {
-    printf("%sSuggested URLs:\n", TEXT_COLOR[theme]);
-    printf("----------------\n");
-    HistoryNode* temp = history->head;
-    int count = 0;
-    while (temp && count < MAX_SUGGESTIONS) {
-        if (strncmp(temp->url, prefix, strlen(prefix)) == 0) {
-            printf("  %s\n", temp->url);
-            count++;
-        }
-        temp = temp->next;
+    unsigned long long start = STAT_START();
+    TRACE_BEGIN("suggestURLs");
+    uiPrintf("%sSuggested URLs:\n", TEXT_COLOR[theme]);
+    uiPrintf("----------------\n");
+    SuggestEntry* matches[MAX_SUGGESTIONS];
+    int count = findSuggestions(&history->suggest, prefix, matches);
+    for (int i = 0; i < count; i++) {
+        uiPrintf("  %s (%d visit%s)\n", urlText(matches[i]->url), matches[i]->visits, matches[i]->visits == 1 ? "" : "s");
     }
-    if (count == 0) printf("  No suggestions found.\n");
-    printf("----------------\n\n%s", ANSI_COLOR_RESET);
+    if (count == 0) uiPrintf("  No suggestions found.\n");
+    uiPrintf("----------------\n\n%s", ANSI_COLOR_RESET);
+    STAT_STOP(STAT_SUGGEST, start);
+    TRACE_END("suggestURLs");
 }
 
-void enterURL(HistoryList* history, TabList* tabs, HashTable* cache, BackStack* stack) {
-    char temp_url[URL_LEN];
-    printf("%sEnter URL (e.g., google.com, https://example.com): %s", TEXT_COLOR[theme], ANSI_COLOR_RESET);
+// Asks for a URL and shows it in the current tab, or in a new one.
+void enterURL(HistoryList* history, TabList* tabs, HashTable* cache, int new_tab) {
+    char temp_url[MAX_URL_LEN];
+    uiPrintf("%sEnter URL (e.g., google.com, https://example.com): %s", TEXT_COLOR[theme], ANSI_COLOR_RESET);
     
-    scanf("%s", temp_url);
+    uiInput();
+    scanf(URL_INPUT_FORMAT, temp_url);
     
     suggestURLs(history, temp_url);
     
     if (validateURL(temp_url)) {
-        addToHistory(history, temp_url);
-        addTab(tabs, temp_url);
-        pushBackStack(stack, temp_url);
+        recordAction(new_tab ? "open" : "visit", temp_url);
+        navigateTo(history, tabs, temp_url, new_tab);
         fetchContent(cache, temp_url);
         showTabs(tabs);
         showHistory(history);
     } else {
-        printf(ANSI_COLOR_RED "\nInvalid URL format! Please try again.\n" ANSI_COLOR_RESET);
+        uiPrintf(ANSI_COLOR_RED "\nInvalid URL format! Please try again.\n" ANSI_COLOR_RESET);
+    }
+}
+
+// Goes back (delta -1) or forward (delta 1) in the current tab.
+void stepCurrentTab(HistoryList* history, TabList* tabs, HashTable* cache, int delta) {
+    UrlId url = tabs->current ? tabStep(tabs->current, delta) : NO_URL;
+    if (url == NO_URL) {
+        uiPrintf(ANSI_COLOR_RED "\nNo more history to go %s!\n" ANSI_COLOR_RESET, delta < 0 ? "back" : "forward");
+        return;
     }
+    recordAction(delta < 0 ? "back" : "forward", NULL);
+    fetchContent(cache, urlText(url));
+    showTabs(tabs);
+    showHistory(history);
 }
 
-void goBack(HistoryList* history, TabList* tabs, BackStack* stack) {
-    char* prev_url = popBackStack(stack);
-    if (prev_url) {
-        HistoryNode* temp = history->head;
-        while (temp && temp->next != history->current) {
-            temp = temp->next;
-        }
-        if (temp) {
-            history->current = temp;
-            addTab(tabs, prev_url);
-            fetchContent(NULL, prev_url);
-            showTabs(tabs);
-            showHistory(history);
-        }
-        free(prev_url);
-    } else {
-        printf(ANSI_COLOR_RED "\nNo more history to go back!\n" ANSI_COLOR_RESET);
-    }
+// Records a visit and shows url in the current tab, or in a new tab when
+// new_tab is set or no tab is open.
+void navigateTo(HistoryList* history, TabList* tabs, const char* url, int new_tab) {
+    addToHistory(history, url);
+    if (new_tab || !tabs->current) addTab(tabs, url);
+    else tabNavigate(tabs->current, internURL(url));
 }
 
-void goHome(HistoryList* history, TabList* tabs, HashTable* cache, BackStack* stack) {
-    addToHistory(history, "home");
-    addTab(tabs, "home");
-    pushBackStack(stack, "home");
+void goHome(HistoryList* history, TabList* tabs, HashTable* cache) {
+    recordAction("home", NULL);
+    navigateTo(history, tabs, "home", 0);
     fetchContent(cache, "home");
     showTabs(tabs);
     showHistory(history);
 }
 
 void setBrowser() {
-    clearScreen();
     showHeader();
-    printf("%sSelect Browser:\n", TEXT_COLOR[theme]);
-    printf("----------------\n");
-    printf("  0. Default Browser\n");
-    printf("  1. Microsoft Edge\n");
-    printf("  2. Google Chrome\n");
-    printf("----------------\n");
-    printf("Enter choice (0-2): %s", ANSI_COLOR_RESET);
+    uiRegion(REGION_BODY);
+    uiPrintf("%sSelect Browser:\n", TEXT_COLOR[theme]);
+    uiPrintf("----------------\n");
+    uiPrintf("  0. Default Browser\n");
+    uiPrintf("  1. Microsoft Edge\n");
+    uiPrintf("  2. Google Chrome\n");
+    uiPrintf("----------------\n");
+    uiPrintf("Enter choice (0-2): %s", ANSI_COLOR_RESET);
     
     int choice;
+    uiInput();
     if (scanf("%d", &choice) != 1 || choice < 0 || choice > 2) {
-        printf(ANSI_COLOR_RED "Invalid choice! Keeping current browser.\n" ANSI_COLOR_RESET);
+        uiPrintf(ANSI_COLOR_RED "Invalid choice! Keeping current browser.\n" ANSI_COLOR_RESET);
     } else {
         browser_choice = choice;
-        printf(ANSI_COLOR_GREEN "Browser set to %s!\n" ANSI_COLOR_RESET, 
+        uiPrintf(ANSI_COLOR_GREEN "Browser set to %s!\n" ANSI_COLOR_RESET, 
                choice == 0 ? "Default" : (choice == 1 ? "Microsoft Edge" : "Google Chrome"));
     }
     getchar();
-    printf("Press Enter to continue...");
+    uiPrintf("Press Enter to continue...");
+    uiInput();
     getchar();
 }
 
 void changeTheme() {
-    clearScreen();
     showHeader();
-    printf("%sSelect Theme:\n", TEXT_COLOR[theme]);
-    printf("----------------\n");
-    printf("  0. Default (Cyan/Yellow)\n");
-    printf("  1. Dark (Blue/Cyan)\n");
-    printf("  2. Light (Green/Magenta)\n");
-    printf("----------------\n");
-    printf("Enter choice (0-2): %s", ANSI_COLOR_RESET);
+    uiRegion(REGION_BODY);
+    uiPrintf("%sSelect Theme:\n", TEXT_COLOR[theme]);
+    uiPrintf("----------------\n");
+    uiPrintf("  0. Default (Cyan/Yellow)\n");
+    uiPrintf("  1. Dark (Blue/Cyan)\n");
+    uiPrintf("  2. Light (Green/Magenta)\n");
+    uiPrintf("----------------\n");
+    uiPrintf("Enter choice (0-2): %s", ANSI_COLOR_RESET);
     
     int choice;
+    uiInput();
     if (scanf("%d", &choice) != 1 || choice < 0 || choice > 2) {
-        printf(ANSI_COLOR_RED "Invalid choice! Keeping current theme.\n" ANSI_COLOR_RESET);
+        uiPrintf(ANSI_COLOR_RED "Invalid choice! Keeping current theme.\n" ANSI_COLOR_RESET);
     } else {
         theme = choice;
-        printf(ANSI_COLOR_GREEN "Theme set to %s!\n" ANSI_COLOR_RESET, 
+        uiPrintf(ANSI_COLOR_GREEN "Theme set to %s!\n" ANSI_COLOR_RESET, 
                choice == 0 ? "Default" : (choice == 1 ? "Dark" : "Light"));
     }
     getchar();
-    printf("Press Enter to continue...");
+    uiPrintf("Press Enter to continue...");
+    uiInput();
     getchar();
 }
 
-int main() {
+// Headless Scripted Mode
+// Replays a command script or a session recorded with --record, one
+// command per line:
+//   visit <url> | back | home | refresh | tab <n> | bookmark
+//   search <keyword> | suggest <prefix> | clear
+// Nothing is rendered and no external browser is launched; the run ends
+// with throughput and per-command latency percentiles.
+void recordAction(const char* command, const char* arg) {
+    if (!session_log) return;
+    if (arg) fprintf(session_log, "%s %s\n", command, arg);
+    else fprintf(session_log, "%s\n", command);
+    fflush(session_log);
+}
+
+int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void addTiming(OpTimings* op, double micros) {
+    if (op->count == op->capacity) {
+        int capacity = op->capacity ? op->capacity * 2 : 256;
+        double* samples = (double*)realloc(op->samples, capacity * sizeof(double));
+        if (!samples) return;
+        op->samples = samples;
+        op->capacity = capacity;
+    }
+    op->samples[op->count++] = micros;
+}
+
+int runScript(const char* path, HistoryList* history, TabList* tabs, HashTable* cache, BookmarkNode** root) {
+    FILE* fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Cannot open script %s\n", path);
+        return 1;
+    }
+    OpTimings ops[] = {
+        { "visit", NULL, 0, 0 }, { "back", NULL, 0, 0 }, { "home", NULL, 0, 0 },
+        { "refresh", NULL, 0, 0 }, { "tab", NULL, 0, 0 }, { "bookmark", NULL, 0, 0 },
+        { "search", NULL, 0, 0 }, { "suggest", NULL, 0, 0 }, { "clear", NULL, 0, 0 },
+        { "reload", NULL, 0, 0 }, { "forward", NULL, 0, 0 }, { "open", NULL, 0, 0 },
+        { "recent", NULL, 0, 0 },
+    };
+    int op_count = (int)(sizeof(ops) / sizeof(ops[0]));
+    Page page = { NULL, 0, 0, 0, 0 };
+    char* line = NULL;
+    size_t size = 0;
+    long lineno = 0, total = 0, errors = 0;
+    double run_start = nowMs();
+
+    while (readRecord(fp, &line, &size)) {
+        lineno++;
+        char* command = line + strspn(line, " \t");
+        if (*command == '\0' || *command == '#') continue;
+        char* arg = command + strcspn(command, " \t");
+        if (*arg) *arg++ = '\0';
+        arg += strspn(arg, " \t");
+        arg[strcspn(arg, "\r")] = '\0';
+
+        int op = 0;
+        while (op < op_count && strcmp(command, ops[op].name) != 0) op++;
+        if (op == op_count) {
+            fprintf(stderr, "%s:%ld: unknown command '%s'\n", path, lineno, command);
+            errors++;
+            continue;
+        }
+
+        double start = nowMs();
+        int ok = 1;
+        TRACE_BEGIN(ops[op].name);
+        if (op == 0) {
+            ok = validateURL(arg);
+            if (ok) {
+                navigateTo(history, tabs, arg, 0);
+                loadPage(cache, internURL(arg), &page);
+            }
+        } else if (op == 1 || op == 10) {
+            UrlId url = tabs->current ? tabStep(tabs->current, op == 1 ? -1 : 1) : NO_URL;
+            if (url != NO_URL) loadPage(cache, url, &page);
+        } else if (op == 2) {
+            navigateTo(history, tabs, "home", 0);
+            loadPage(cache, internURL("home"), &page);
+        } else if (op == 3) {
+            ok = tabs->current != NULL;
+            if (ok) loadPage(cache, tabs->current->url, &page);
+        } else if (op == 4) {
+            int index = atoi(arg);
+            ok = index >= 1 && index <= tabs->tab_count;
+            if (ok) {
+                switchTab(tabs, index);
+                loadPage(cache, tabs->current->url, &page);
+            }
+        } else if (op == 5) {
+            ok = tabs->current != NULL;
+            if (ok && !bookmarkExists(*root, urlText(tabs->current->url))) {
+                *root = insertBookmark(*root, urlText(tabs->current->url));
+                journalAppend('B', urlText(tabs->current->url));
+            }
+        } else if (op == 6) {
+            int found = 0;
+            free(findInHistory(history, arg, &found));
+        } else if (op == 7) {
+            SuggestEntry* matches[MAX_SUGGESTIONS];
+            findSuggestions(&history->suggest, arg, matches);
+        } else if (op == 8) {
+            if (*arg) {
+                long long from = (long long)time(NULL) - atoll(arg);
+                deleteHistoryRange(history, from, LLONG_MAX);
+                journalRecord("X:%lld:%lld\n", from, LLONG_MAX);
+            } else {
+                freeHistory(history);
+                journalAppend('C', "");
+            }
+        } else if (op == 9) {
+            refreshAllTabs(&loader, tabs);
+            waitLoaderPool(&loader);
+        } else if (op == 11) {
+            ok = validateURL(arg);
+            if (ok) {
+                navigateTo(history, tabs, arg, 1);
+                loadPage(cache, internURL(arg), &page);
+            }
+        } else if (op == 12) {
+            HistoryEntry* found[HISTORY_VIEW_ENTRIES];
+            findHistoryRange(history, (long long)time(NULL) - atoll(arg), LLONG_MAX, found, HISTORY_VIEW_ENTRIES);
+        }
+        TRACE_END(ops[op].name);
+        addTiming(&ops[op], (nowMs() - start) * 1000.0);
+        total++;
+        if (!ok) {
+            fprintf(stderr, "%s:%ld: cannot %s %s\n", path, lineno, command, arg);
+            errors++;
+        }
+        TRACE_BEGIN("idle work");
+        // idle work, untimed
+        compactData(history, *root);
+        hibernateTabs(tabs, cache);
+        if (tabs->current) {
+            prefetchPages(&loader, history, tabs->current->url);
+            waitLoaderPool(&loader); // keeps scripted runs reproducible
+        }
+        TRACE_END("idle work");
+    }
+    double elapsed = nowMs() - run_start;
+    journalSync();
+    freePage(&page);
+    free(line);
+    if (fp != stdin) fclose(fp);
+
+    printf("Replayed %ld operations in %.2f ms (%.0f ops/s), %ld errors\n",
+           total, elapsed, elapsed > 0 ? total * 1000.0 / elapsed : 0.0, errors);
+    printf("Cache: %ld hits, %ld misses; prefetch: %ld pages warmed, %ld used, %ld wasted (%zu bytes)\n",
+           cache->hits, cache->misses, cache->prefetches, cache->prefetch_hits,
+           cache->prefetch_wasted, cache->prefetch_wasted_bytes);
+    if (cache->page_bytes > 0) {
+        printf("Compression: %llu page bytes stored in %llu (%.1f%%), %ld decodes, mean %.2f us\n",
+               cache->page_bytes, cache->stored_bytes, 100.0 * cache->stored_bytes / cache->page_bytes,
+               cache->decodes, cache->decodes ? cache->decode_ms * 1000.0 / cache->decodes : 0.0);
+    }
+    printf("History: %d URLs from %ld visits, %ld dropped by retention, %ld deleted\n",
+           history->size, history->visits, history->pruned, history->deleted);
+    if (tabs->hibernations > 0) {
+        printf("Tabs: %d open, %d hibernated; %ld hibernations, %ld restored\n",
+               tabs->tab_count, tabs->hibernated, tabs->hibernations, tabs->restores);
+    }
+    if (cache->disk) {
+        printf("Disk cache: %ld hits, %ld misses, %ld pages written, %ld overwritten, %ld corrupt\n",
+               cache->disk->hits, cache->disk->misses, cache->disk->spills, cache->disk->drops, cache->disk->corrupt);
+    }
+    printf("%-10s %10s %12s %10s %10s %10s %10s\n", "op", "count", "mean_us", "p50_us", "p90_us", "p99_us", "max_us");
+    for (int i = 0; i < op_count; i++) {
+        if (ops[i].count == 0) continue;
+        double sum = 0;
+        for (int j = 0; j < ops[i].count; j++) sum += ops[i].samples[j];
+        qsort(ops[i].samples, ops[i].count, sizeof(double), compareDoubles);
+        int n = ops[i].count;
+        printf("%-10s %10d %12.2f %10.2f %10.2f %10.2f %10.2f\n", ops[i].name, n, sum / n,
+               ops[i].samples[n / 2], ops[i].samples[(int)(n * 0.90)], ops[i].samples[(int)(n * 0.99)],
+               ops[i].samples[n - 1]);
+        free(ops[i].samples);
+    }
+    return errors ? 2 : 0;
+}
+
+// Returns path made absolute against the current directory, so a file
+// named on the command line stays where the user meant after --data-dir
+// changes directory. The result is never freed; it lives as long as the
+// arguments do.
+const char* absolutePath(const char* path) {
+    #ifdef _WIN32
+        char* full = _fullpath(NULL, path, 0);
+        return full ? full : path;
+    #else
+        char cwd[4096];
+        if (path[0] == '/' || !getcwd(cwd, sizeof(cwd))) return path;
+        char* full = (char*)malloc(strlen(cwd) + strlen(path) + 2);
+        if (!full) return path;
+        sprintf(full, "%s/%s", cwd, path);
+        return full;
+    #endif
+}
+
+#ifndef BROWSER_BENCH
+int main(int argc, char* argv[]) {
     setlocale(LC_ALL, "");
+    const char* script = NULL;
+    const char* data_dir = NULL;
+    const char* launch_command = getenv("SURF_LAUNCHER");
+    int http_timeout = HTTP_TIMEOUT_MS;
+    int workers = loaderWorkerCount();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--convert") == 0 && i + 2 < argc) {
+            return convertProfile(argv[i + 1], argv[i + 2]);
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            script = argv[++i];
+            if (strcmp(script, "-") != 0) script = absolutePath(script);
+            headless = 1;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            session_log = fopen(argv[++i], "a");
+            if (!session_log) {
+                fprintf(stderr, "Cannot open %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            return serveHttp(atoi(argv[i + 1]));
+        } else if (strcmp(argv[i], "--prefetch-budget") == 0 && i + 1 < argc) {
+            prefetch_budget = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--disk-cache") == 0 && i + 1 < argc) {
+            disk_cache_bytes = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--history-limit") == 0 && i + 1 < argc) {
+            history_limit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--history-days") == 0 && i + 1 < argc) {
+            history_max_age = (long long)(atof(argv[++i]) * 86400);
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_path = absolutePath(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = absolutePath(argv[++i]);
+            tracing = 1;
+        } else if (strcmp(argv[i], "--hibernate") == 0 && i + 1 < argc) {
+            hibernate_after_ms = atof(argv[++i]) * 1000.0;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            http_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--launcher") == 0 && i + 1 < argc) {
+            launch_command = argv[++i];
+        } else if (strcmp(argv[i], "--data-dir") == 0 && i + 1 < argc) {
+            data_dir = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--data-dir DIR] [--launcher COMMAND] [--timeout MS] [--prefetch-budget BYTES]\n"
+                            "       %*s [--workers N] [--disk-cache BYTES] [--hibernate SECS] [--history-limit N]\n"
+                            "       %*s [--history-days DAYS] [--stats FILE] [--trace FILE] [--record FILE]\n"
+                            "       %*s [--script FILE|-]\n"
+                            "       %s --convert TEXT_PROFILE BINARY_PROFILE\n"
+                            "       %s --serve PORT\n", argv[0], (int)strlen(argv[0]), "",
+                            (int)strlen(argv[0]), "", (int)strlen(argv[0]), "", argv[0], argv[0]);
+            return 1;
+        }
+    }
+    // Only after every file argument is open or absolute, so they do not
+    // depend on where --data-dir appears.
+    if (data_dir && chdir(data_dir) != 0) {
+        fprintf(stderr, "Cannot use data directory %s\n", data_dir);
+        return 1;
+    }
 
     HistoryList history;
     TabList tabs;
     HashTable cache;
-    BackStack stack;
     BookmarkNode* bookmark_root = initBookmarks();
     
+    statInit();
+    TRACE_THREAD("main");
     initHistory(&history);
     initTabs(&tabs);
     initHashTable(&cache);
-    initBackStack(&stack);
     
     loadData(&history, &bookmark_root);
-    goHome(&history, &tabs, &cache, &stack);
+    openJournal();
+    initHttpClient();
+    if (http_timeout > 0) http.timeout_ms = http_timeout;
+    if (disk_cache_bytes > 0 && openDiskCache(&disk_cache, disk_cache_bytes)) cache.disk = &disk_cache;
+    initLoaderPool(&loader, &cache, workers);
+    if (script) {
+        int status = runScript(script, &history, &tabs, &cache, &bookmark_root);
+        if (journal.fp) fclose(journal.fp);
+        shutdownLoaderPool(&loader);
+        spillCache(&cache);
+        writeStats(stats_path, &cache);
+        writeTrace(trace_path);
+        closeDiskCache(&disk_cache);
+        closeHttpConnections();
+        return status;
+    }
+    uiInit();
+    initLauncher(launch_command);
+    goHome(&history, &tabs, &cache);
     
     while (1) {
+        TRACE_BEGIN("idle work");
+        flushLaunches();
+        hibernateTabs(&tabs, &cache);
+        if (tabs.current) prefetchPages(&loader, &history, tabs.current->url);
+        compactData(&history, bookmark_root);
+        journalSync(); // group commit before blocking on input
+        TRACE_END("idle work");
         showMenu();
         int choice;
+        uiInput();
         if (scanf("%d", &choice) != 1) {
             while (getchar() != '\n');
-            printf(ANSI_COLOR_RED "Invalid input! Please enter a number.\n" ANSI_COLOR_RESET);
+            uiPrintf(ANSI_COLOR_RED "Invalid input! Please enter a number.\n" ANSI_COLOR_RESET);
             continue;
         }
         
+        const char* action = choice >= 1 && choice <= 16 ? MENU_ACTIONS[choice] : "Invalid option";
+        TRACE_BEGIN(action);
         switch (choice) {
             case 1:
                 while (getchar() != '\n');
-                enterURL(&history, &tabs, &cache, &stack);
+                enterURL(&history, &tabs, &cache, 0);
                 break;
             case 2:
-                fetchContent(&cache, tabs.current->url);
+                recordAction("refresh", NULL);
+                fetchContent(&cache, urlText(tabs.current->url));
                 showTabs(&tabs);
                 showHistory(&history);
                 break;
             case 3:
-                goBack(&history, &tabs, &stack);
+                stepCurrentTab(&history, &tabs, &cache, -1);
                 break;
             case 4:
-                goHome(&history, &tabs, &cache, &stack);
+                goHome(&history, &tabs, &cache);
                 break;
             case 5:
                 while (getchar() != '\n');
-                enterURL(&history, &tabs, &cache, &stack);
+                enterURL(&history, &tabs, &cache, 1);
                 break;
             case 6:
                 showTabs(&tabs);
-                printf("Enter tab number to switch to: ");
+                uiPrintf("Enter tab number to switch to: ");
                 int tab_index;
+                uiInput();
                 scanf("%d", &tab_index);
+                char tab_arg[16];
+                snprintf(tab_arg, sizeof(tab_arg), "%d", tab_index);
+                recordAction("tab", tab_arg);
                 switchTab(&tabs, tab_index);
-                fetchContent(&cache, tabs.current->url);
+                fetchContent(&cache, urlText(tabs.current->url));
                 showTabs(&tabs);
                 showHistory(&history);
                 break;
@@ -825,76 +5650,921 @@ int main() {
                 break;
             case 8:
                 clearHistory(&history);
-                printf("Press Enter to continue...");
+                uiPrintf("Press Enter to continue...");
+                uiInput();
                 getchar();
                 getchar();
-                clearScreen();
                 showHeader();
                 showTabs(&tabs);
                 showHistory(&history);
                 break;
             case 9:
-                searchHistory(&history, &tabs, &cache, &stack);
-                clearScreen();
+                searchHistory(&history, &tabs, &cache);
                 showHeader();
                 showTabs(&tabs);
                 showHistory(&history);
                 break;
             case 10:
                 changeTheme();
-                clearScreen();
                 showHeader();
                 showTabs(&tabs);
                 showHistory(&history);
                 break;
             case 11:
                 addBookmark(&bookmark_root, &tabs);
-                clearScreen();
                 showHeader();
                 showTabs(&tabs);
                 showHistory(&history);
                 break;
             case 12:
-                viewBookmarks(bookmark_root, &history, &tabs, &cache, &stack);
-                clearScreen();
+                viewBookmarks(bookmark_root, &history, &tabs, &cache);
                 showHeader();
                 showTabs(&tabs);
                 showHistory(&history);
                 break;
             case 13:
+                recordAction("reload", NULL);
+                refreshAllTabs(&loader, &tabs);
+                showHeader();
+                showTabs(&tabs);
+                showHistory(&history);
+                break;
+            case 14:
+                stepCurrentTab(&history, &tabs, &cache, 1);
+                break;
+            case 15:
+                showHeader();
+                showStats(&cache);
+                uiPrintf("Press Enter to continue...");
+                uiInput();
+                getchar();
+                getchar();
+                showHeader();
+                showTabs(&tabs);
+                showHistory(&history);
+                break;
+            case 16:
                 clearScreen();
-                printf(ANSI_COLOR_GREEN "\nThanks for browsing, Pranav! Goodbye!\n" ANSI_COLOR_RESET);
-                while (history.head) {
-                    HistoryNode* temp = history.head;
-                    history.head = history.head->next;
-                    free(temp);
-                }
-                while (tabs.tab_count > 0) {
-                    TabNode* temp = tabs.current;
-                    tabs.current->prev->next = tabs.current->next;
-                    tabs.current->next->prev = tabs.current->prev;
-                    tabs.current = tabs.current->next;
-                    free(temp);
-                    tabs.tab_count--;
-                }
-                for (int i = 0; i < HASH_SIZE; i++) {
-                    while (cache.table[i]) {
-                        CacheNode* temp = cache.table[i];
-                        cache.table[i] = cache.table[i]->next;
-                        free(temp);
-                    }
-                }
-                while (stack.top) {
-                    StackNode* temp = stack.top;
-                    stack.top = stack.top->next;
-                    free(temp);
-                }
+                uiPrintf(ANSI_COLOR_GREEN "\nThanks for browsing, Pranav! Goodbye!\n" ANSI_COLOR_RESET);
+                uiFlush();
+                journalSync();
+                if (journal.fp) fclose(journal.fp);
+                shutdownLoaderPool(&loader);
+                spillCache(&cache);
+                writeStats(stats_path, &cache);
+                TRACE_END(action);
+                writeTrace(trace_path);
+                closeDiskCache(&disk_cache);
+                closeHttpConnections();
+                freeHistory(&history);
+                freeTabs(&tabs);
+                freeCache(&cache);
                 freeBookmarks(bookmark_root);
+                freeURLs();
                 exit(0);
             default:
-                printf(ANSI_COLOR_RED "Invalid option! Choose 1-13.\n" ANSI_COLOR_RESET);
+                uiPrintf(ANSI_COLOR_RED "Invalid option! Choose 1-16.\n" ANSI_COLOR_RESET);
         }
+        TRACE_END(action);
     }
     
     return 0;
-}
\ No newline at end of file
+}
+#endif
+
+#ifdef BROWSER_BENCH
+// Microbenchmarks, built with: gcc -O2 -DBROWSER_BENCH webbrowser.c -o webbrowser_bench -lm -pthread
+// (add -lpsapi with MinGW)
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// The chained 100-bucket cache this browser shipped with, kept as a baseline.
+#define LEGACY_HASH_SIZE 100
+#define LEGACY_URL_LEN 100
+#define LEGACY_CONTENT_LEN 500
+
+typedef struct LegacyCacheNode {
+    char url[LEGACY_URL_LEN];
+    char content[LEGACY_CONTENT_LEN];
+    struct LegacyCacheNode* next;
+} LegacyCacheNode;
+
+typedef struct {
+    LegacyCacheNode* table[LEGACY_HASH_SIZE];
+} LegacyCache;
+
+unsigned int legacyHash(const char* url) {
+    unsigned int hash = 0;
+    while (*url) {
+        hash = (hash * 31 + *url) % LEGACY_HASH_SIZE;
+        url++;
+    }
+    return hash;
+}
+
+void legacyAddToCache(LegacyCache* cache, const char* url, const char* content) {
+    unsigned int index = legacyHash(url);
+    LegacyCacheNode* newNode = (LegacyCacheNode*)malloc(sizeof(LegacyCacheNode));
+    if (!newNode) return;
+    strncpy(newNode->url, url, LEGACY_URL_LEN - 1);
+    newNode->url[LEGACY_URL_LEN - 1] = '\0';
+    strncpy(newNode->content, content, LEGACY_CONTENT_LEN - 1);
+    newNode->content[LEGACY_CONTENT_LEN - 1] = '\0';
+    newNode->next = cache->table[index];
+    cache->table[index] = newNode;
+}
+
+char* legacyGetFromCache(LegacyCache* cache, const char* url) {
+    LegacyCacheNode* temp = cache->table[legacyHash(url)];
+    while (temp) {
+        if (strcmp(temp->url, url) == 0) return temp->content;
+        temp = temp->next;
+    }
+    return NULL;
+}
+
+void legacyFreeCache(LegacyCache* cache) {
+    for (int i = 0; i < LEGACY_HASH_SIZE; i++) {
+        while (cache->table[i]) {
+            LegacyCacheNode* temp = cache->table[i];
+            cache->table[i] = temp->next;
+            free(temp);
+        }
+    }
+}
+
+// Synthetic URLs shaped like real ones: a host, a path and a query.
+char** makeBenchURLs(int n, const char* salt) {
+    char** urls = (char**)malloc(n * sizeof(char*));
+    for (int i = 0; i < n; i++) {
+        urls[i] = (char*)malloc(LEGACY_URL_LEN);
+        snprintf(urls[i], LEGACY_URL_LEN, "https://site%d.example.com/%s/page/%d?id=%d", i % 997, salt, i, i * 7919);
+    }
+    return urls;
+}
+
+void freeBenchURLs(char** urls, int n) {
+    for (int i = 0; i < n; i++) free(urls[i]);
+    free(urls);
+}
+
+// Results
+// Each benchmark times every operation on its own and prints one JSON
+// object per line: wall-clock throughput of the loop (timers included, so
+// it understates the fastest operations), latency percentiles in
+// nanoseconds (timer overhead subtracted) and the process's peak RSS so far. Corpus sizes run
+// smallest first, so the peak RSS of a line covers that size.
+typedef struct {
+    double* samples;  // nanoseconds per operation
+    long count;
+    long capacity;
+    double started;
+} BenchTimer;
+
+double timer_overhead_ns = 0;
+const char* bench_filter = NULL;
+
+long peakRssKb() {
+    #ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return (long)(counters.PeakWorkingSetSize / 1024);
+    #else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+        #ifdef __APPLE__
+            return usage.ru_maxrss / 1024; // bytes on macOS
+        #else
+            return usage.ru_maxrss;
+        #endif
+    #endif
+}
+
+void calibrateTimer() {
+    double samples[1001];
+    for (int i = 0; i < 1001; i++) {
+        double start = nowMs();
+        samples[i] = (nowMs() - start) * 1e6;
+    }
+    qsort(samples, 1001, sizeof(double), compareDoubles);
+    timer_overhead_ns = samples[500];
+}
+
+int benchEnabled(const char* name) {
+    return !bench_filter || strstr(name, bench_filter) != NULL;
+}
+
+void benchBegin(BenchTimer* timer, long ops) {
+    timer->samples = (double*)malloc((ops > 0 ? ops : 1) * sizeof(double));
+    timer->count = 0;
+    timer->capacity = timer->samples ? ops : 0;
+    timer->started = nowMs();
+}
+
+// Records one operation that began at start (a nowMs() reading).
+void benchSample(BenchTimer* timer, double start) {
+    double ns = (nowMs() - start) * 1e6 - timer_overhead_ns;
+    if (timer->count < timer->capacity) timer->samples[timer->count++] = ns > 0 ? ns : 0;
+}
+
+void benchReport(BenchTimer* timer, const char* name, int n) {
+    double elapsed_ms = nowMs() - timer->started;
+    long ops = timer->count;
+    double sum = 0;
+    for (long i = 0; i < ops; i++) sum += timer->samples[i];
+    qsort(timer->samples, ops, sizeof(double), compareDoubles);
+    #define BENCH_PCT(p) (ops ? timer->samples[(long)((ops - 1) * (p))] : 0.0)
+    printf("{\"bench\":\"%s\",\"n\":%d,\"ops\":%ld,\"elapsed_ms\":%.3f,\"ops_per_sec\":%.0f,"
+           "\"mean_ns\":%.1f,\"p50_ns\":%.1f,\"p90_ns\":%.1f,\"p99_ns\":%.1f,\"max_ns\":%.1f,\"peak_rss_kb\":%ld}\n",
+           name, n, ops, elapsed_ms, elapsed_ms > 0 ? ops * 1000.0 / elapsed_ms : 0.0,
+           ops ? sum / ops : 0.0, BENCH_PCT(0.50), BENCH_PCT(0.90), BENCH_PCT(0.99), BENCH_PCT(1.0), peakRssKb());
+    #undef BENCH_PCT
+    fflush(stdout);
+    free(timer->samples);
+    timer->samples = NULL;
+}
+
+// xorshift64, so corpora are identical from run to run
+unsigned long long bench_rng = 88172645463325252ULL;
+
+unsigned long long benchRandom() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 7;
+    bench_rng ^= bench_rng << 17;
+    return bench_rng;
+}
+
+// Skewed pick in [0, n): low indexes come up far more often, like the few
+// sites a user keeps returning to.
+int benchPick(int n) {
+    unsigned long long span = benchRandom() % (unsigned long long)n + 1;
+    return (int)(benchRandom() % span);
+}
+
+// The legacy cache degrades to a linear scan of its 100 chains, so it is
+// only compared at sizes where that still finishes.
+void benchLegacyCache(char** urls, char** missing, int n) {
+    const char* content = "| Benchmark page                             |\n";
+    volatile long found = 0;
+    LegacyCache legacy;
+    memset(&legacy, 0, sizeof(legacy));
+    BenchTimer timer;
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        legacyAddToCache(&legacy, urls[i], content);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "cache.legacy.add", n);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        found += legacyGetFromCache(&legacy, urls[i]) != NULL;
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "cache.legacy.get_hit", n);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        found += legacyGetFromCache(&legacy, missing[i]) != NULL;
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "cache.legacy.get_miss", n);
+    legacyFreeCache(&legacy);
+}
+
+// Disk cache sized to hold every page: spills n pages, faults each back
+// in, then times saving the index and reopening the cache from it.
+void benchDiskCache(UrlId* ids, UrlId* missing_ids, int n) {
+    const char* content = "| Benchmark page                             |\n";
+    uint32_t length = (uint32_t)strlen(content), stored, got_stored, got_length;
+    unsigned char* blob = encodePage(content, length, &stored);
+    DiskCache disk;
+    BenchTimer timer;
+    if (!blob || !openDiskCache(&disk, (size_t)n * 192 + 4096)) {
+        free(blob);
+        return;
+    }
+
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        diskCacheStore(&disk, ids[i], blob, stored, length);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "disk.store", n);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        free(diskCacheLoad(&disk, ids[benchPick(n)], &got_stored, &got_length));
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "disk.load_hit", n);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        free(diskCacheLoad(&disk, missing_ids[i], &got_stored, &got_length));
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "disk.load_miss", n);
+    size_t capacity = (size_t)disk.capacity;
+    benchBegin(&timer, 1);
+    double start = nowMs();
+    closeDiskCache(&disk);
+    openDiskCache(&disk, capacity);
+    benchSample(&timer, start);
+    benchReport(&timer, "disk.close_reopen", n);
+    closeDiskCache(&disk);
+    remove(DISK_CACHE_DATA);
+    remove(DISK_CACHE_INDEX);
+    free(blob);
+}
+
+// Markup-like text: repeated tags around varying words and numbers.
+void makeBenchPage(Page* page, size_t length) {
+    static const char* words[] = { "browser", "cache", "page", "history", "tab", "bookmark", "network", "render" };
+    char line[256];
+    pageSet(page, "", 0);
+    while (page->length < length) {
+        int item = (int)(benchRandom() % 100000);
+        int size = snprintf(line, sizeof(line), "<li class=\"item\"><a href=\"/%s/%d\">%s %s</a> <span>%d</span></li>\n",
+                            words[item % 8], item, words[(item / 8) % 8], words[(item / 64) % 8], item % 997);
+        if (!pageReserve(page, page->length + size)) return;
+        memcpy(page->text + page->length, line, size);
+        page->length += size;
+    }
+    page->length = length;
+    page->text[length] = '\0';
+}
+
+// Page codec on pages of growing size; n is the page size in bytes and
+// the compression ratio goes to stderr.
+void benchCompression() {
+    static const size_t sizes[] = { 1 << 10, 16 << 10, 256 << 10 };
+    Page page = { NULL, 0, 0, 0, 0 }, decoded = { NULL, 0, 0, 0, 0 };
+    BenchTimer timer;
+    char name[64];
+    for (int s = 0; s < 3; s++) {
+        int rounds = (int)((4 << 20) / sizes[s]);
+        makeBenchPage(&page, sizes[s]);
+        uint32_t stored = 0;
+        unsigned char* blob = NULL;
+        benchBegin(&timer, rounds);
+        for (int i = 0; i < rounds; i++) {
+            free(blob);
+            double start = nowMs();
+            blob = encodePage(page.text, page.length, &stored);
+            benchSample(&timer, start);
+        }
+        snprintf(name, sizeof(name), "lz.compress_%zukb", sizes[s] >> 10);
+        benchReport(&timer, name, (int)sizes[s]);
+        benchBegin(&timer, rounds);
+        for (int i = 0; i < rounds; i++) {
+            double start = nowMs();
+            decodePage(blob, stored, (uint32_t)page.length, &decoded);
+            benchSample(&timer, start);
+        }
+        snprintf(name, sizeof(name), "lz.decompress_%zukb", sizes[s] >> 10);
+        benchReport(&timer, name, (int)sizes[s]);
+        if (decoded.length != page.length || memcmp(decoded.text, page.text, page.length) != 0) {
+            fprintf(stderr, "lz: round trip of %zu bytes failed\n", page.length);
+        }
+        fprintf(stderr, "lz: %zu byte page stored in %u bytes (%.1f%%)\n", page.length, stored, 100.0 * stored / page.length);
+        free(blob);
+    }
+    freePage(&page);
+    freePage(&decoded);
+}
+
+// Cache keyed by UrlId; the browser interns a URL once when it is entered.
+// Runs once with an unbounded budget (every get hits or misses on the
+// table itself) and once with the default budget, where adds evict.
+void benchCache(UrlId* ids, UrlId* missing_ids, int n) {
+    const char* content = "| Benchmark page                             |\n";
+    size_t length = strlen(content);
+    Page page = { NULL, 0, 0, 0, 0 };
+    volatile long found = 0;
+    HashTable cache;
+    BenchTimer timer;
+
+    initHashTable(&cache);
+    setCacheBudget(&cache, (size_t)-1);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        addToCache(&cache, ids[i], content, length);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "cache.add", n);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        found += getFromCache(&cache, ids[i], &page);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "cache.get_hit", n);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        found += getFromCache(&cache, missing_ids[i], &page);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "cache.get_miss", n);
+    freeCache(&cache);
+
+    initHashTable(&cache);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        UrlId url = ids[benchPick(n)];
+        if (!getFromCache(&cache, url, &page)) addToCache(&cache, url, content, length);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "cache.get_or_add_budgeted", n);
+    freeCache(&cache);
+    freePage(&page);
+}
+
+// Builds a linked list of n history-sized nodes and tears it down, once
+// with malloc/free per node and once from a NodePool. Allocation is timed
+// per node; each teardown is one operation covering the whole list.
+void benchPools(int n) {
+    BenchTimer timer;
+    HistoryEntry* head = NULL;
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        HistoryEntry* node = (HistoryEntry*)malloc(sizeof(HistoryEntry));
+        node->seq = i;
+        node->next = head;
+        head = node;
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "nodes.malloc.alloc", n);
+    benchBegin(&timer, 1);
+    double start = nowMs();
+    while (head) {
+        HistoryEntry* next = head->next;
+        free(head);
+        head = next;
+    }
+    benchSample(&timer, start);
+    benchReport(&timer, "nodes.malloc.teardown", n);
+
+    NodePool pool;
+    initPool(&pool, sizeof(HistoryEntry));
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        HistoryEntry* node = (HistoryEntry*)poolAlloc(&pool);
+        node->seq = i;
+        node->next = head;
+        head = node;
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "nodes.pool.alloc", n);
+    benchBegin(&timer, 1);
+    start = nowMs();
+    poolReleaseAll(&pool);
+    benchSample(&timer, start);
+    benchReport(&timer, "nodes.pool.teardown", n);
+}
+
+// History: n visits over a corpus of n URLs, then prefix suggestions and
+// keyword searches against it, then a save and load of the profile.
+void benchHistory(char** urls, int n) {
+    HistoryList history;
+    BookmarkNode* root = initBookmarks();
+    BenchTimer timer;
+    char query[64];
+    initHistory(&history);
+
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        const char* url = urls[benchPick(n)];
+        double start = nowMs();
+        addToHistory(&history, url);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "history.add", n);
+
+    if (benchEnabled("history.suggest")) {
+        int queries = n < 10000 ? n : 10000;
+        SuggestEntry* matches[MAX_SUGGESTIONS];
+        benchBegin(&timer, queries);
+        for (int i = 0; i < queries; i++) {
+            snprintf(query, sizeof(query), "https://site%d", (int)(benchRandom() % 997));
+            double start = nowMs();
+            findSuggestions(&history.suggest, query, matches);
+            benchSample(&timer, start);
+        }
+        benchReport(&timer, "history.suggest", n);
+    }
+
+    if (benchEnabled("history.search")) {
+        int queries = n < 1000 ? n : 1000;
+        benchBegin(&timer, queries);
+        for (int i = 0; i < queries; i++) {
+            snprintf(query, sizeof(query), "page/%d", benchPick(n));
+            int found = 0;
+            double start = nowMs();
+            free(findInHistory(&history, query, &found));
+            benchSample(&timer, start);
+        }
+        benchReport(&timer, "history.search", n);
+    }
+
+    if (benchEnabled("profile.")) {
+        for (int i = 0; i < n / 10 + 1; i++) {
+            root = insertBookmark(root, urls[benchPick(n)]);
+        }
+        int rounds = 5;
+        benchBegin(&timer, rounds);
+        for (int i = 0; i < rounds; i++) {
+            double start = nowMs();
+            saveData(&history, root);
+            benchSample(&timer, start);
+        }
+        benchReport(&timer, "profile.save", n);
+
+        benchBegin(&timer, rounds);
+        for (int i = 0; i < rounds; i++) {
+            freeHistory(&history);
+            freeBookmarks(root);
+            freeURLs();
+            initHistory(&history);
+            root = initBookmarks();
+            double start = nowMs();
+            loadData(&history, &root);
+            benchSample(&timer, start);
+        }
+        benchReport(&timer, "profile.load", n);
+        remove(PROFILE_FILE);
+        remove(JOURNAL_FILE);
+    }
+
+    if (benchEnabled("history.range") || benchEnabled("history.delete_range")) {
+        // One visit a minute, so an hour spans about 60 entries
+        freeHistory(&history);
+        long long base = 1700000000;
+        for (int i = 0; i < n; i++) appendHistory(&history, internURL(urls[i]), base + i * 60LL);
+        long long span = (long long)n * 60;
+        int queries = n < 10000 ? n : 10000;
+        HistoryEntry* found[HISTORY_VIEW_ENTRIES];
+        benchBegin(&timer, queries);
+        for (int i = 0; i < queries; i++) {
+            long long from = base + (long long)(benchRandom() % (unsigned long long)span);
+            double start = nowMs();
+            findHistoryRange(&history, from, from + 3600, found, HISTORY_VIEW_ENTRIES);
+            benchSample(&timer, start);
+        }
+        benchReport(&timer, "history.range", n);
+
+        int deletions = n / 120 < 1000 ? n / 120 + 1 : 1000;
+        benchBegin(&timer, deletions);
+        for (int i = 0; i < deletions; i++) {
+            long long from = base + (long long)(benchRandom() % (unsigned long long)span);
+            double start = nowMs();
+            deleteHistoryRange(&history, from, from + 3600);
+            benchSample(&timer, start);
+        }
+        benchReport(&timer, "history.delete_range", n);
+    }
+    freeHistory(&history);
+    freeBookmarks(root);
+}
+
+void benchTabs(char** urls, int n) {
+    TabList tabs;
+    BenchTimer timer;
+    initTabs(&tabs);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        addTab(&tabs, urls[i]);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "tabs.open", n);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        int index = (int)(benchRandom() % tabs.tab_count) + 1;
+        double start = nowMs();
+        switchTab(&tabs, index);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "tabs.switch", n);
+    freeTabs(&tabs);
+}
+
+void benchBookmarks(char** urls, char** missing, int n) {
+    BookmarkNode* root = initBookmarks();
+    BenchTimer timer;
+    volatile long found = 0;
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        root = insertBookmark(root, urls[i]);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "bookmarks.insert", n);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        const char* url = (i & 1) ? urls[benchRandom() % n] : missing[benchRandom() % n];
+        double start = nowMs();
+        found += bookmarkExists(root, url);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "bookmarks.exists", n);
+    freeBookmarks(root);
+}
+
+// One tab taken through n visits, then back and forward over the
+// TAB_NAV_DEPTH pages it keeps, turning around at either end.
+void benchTabNavigation(char** urls, int n) {
+    TabList tabs;
+    BenchTimer timer;
+    initTabs(&tabs);
+    addTab(&tabs, urls[0]);
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        tabNavigate(tabs.current, internURL(urls[i]));
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "nav.visit", n);
+    int delta = -1;
+    benchBegin(&timer, n);
+    for (int i = 0; i < n; i++) {
+        double start = nowMs();
+        if (tabStep(tabs.current, delta) == NO_URL) {
+            delta = -delta;
+            tabStep(tabs.current, delta);
+        }
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "nav.step", n);
+    freeTabs(&tabs);
+}
+
+// Time to hand URLs to the launcher, with the stub command "true" standing
+// in for a browser: one URL per flush, and bursts of LAUNCH_BATCH_MAX.
+void benchLauncher() {
+    BenchTimer timer;
+    char url[64];
+    int rounds = 200;
+    benchBegin(&timer, rounds);
+    for (int i = 0; i < rounds; i++) {
+        snprintf(url, sizeof(url), "site%d.example.com", i);
+        double start = nowMs();
+        openURLInBrowser(url);
+        flushLaunches();
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "launch.single", rounds);
+    benchBegin(&timer, rounds);
+    for (int i = 0; i < rounds; i++) {
+        double start = nowMs();
+        for (int j = 0; j < LAUNCH_BATCH_MAX; j++) {
+            snprintf(url, sizeof(url), "site%d.example.com/%d", i, j);
+            openURLInBrowser(url);
+        }
+        flushLaunches();
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "launch.burst", rounds);
+}
+
+#ifndef _WIN32
+// Page loads against the loopback server, forked on an ephemeral port:
+// small pages over pooled keep-alive connections, the same pages with a
+// new connection per request, and 1 MB bodies for transfer throughput.
+void benchHttp() {
+    int port;
+    int listen_fd = openHttpListener(0, &port);
+    if (listen_fd < 0) return;
+    pid_t server = fork();
+    if (server == 0) {
+        runHttpServer(listen_fd);
+        _exit(0);
+    }
+    close(listen_fd);
+    initHttpClient();
+
+    BenchTimer timer;
+    char url[128];
+    Page page = { NULL, 0, 0, 0, 0 };
+    int rounds = 2000;
+    const char* names[] = { "http.fetch_keepalive", "http.fetch_new_connection" };
+    for (int keep_alive = 1; keep_alive >= 0; keep_alive--) {
+        http.keep_alive = keep_alive;
+        benchBegin(&timer, rounds);
+        for (int i = 0; i < rounds; i++) {
+            snprintf(url, sizeof(url), "http://127.0.0.1:%d/bytes/%d", port, 256 + i % 1024);
+            double start = nowMs();
+            httpFetch(url, &page);
+            benchSample(&timer, start);
+        }
+        benchReport(&timer, names[1 - keep_alive], rounds);
+    }
+    http.keep_alive = 1;
+    rounds = 100;
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/chunked/1048576", port);
+    benchBegin(&timer, rounds);
+    for (int i = 0; i < rounds; i++) {
+        double start = nowMs();
+        httpFetch(url, &page);
+        benchSample(&timer, start);
+    }
+    benchReport(&timer, "http.fetch_1mb_chunked", rounds);
+    freePage(&page);
+    closeHttpConnections();
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+}
+
+// Reloads a batch of tabs from the loopback server through loader pools of
+// growing size; one sample per batch. Every batch uses new URLs so each
+// load goes to the server.
+void benchLoaderPool() {
+    int port;
+    int listen_fd = openHttpListener(0, &port);
+    if (listen_fd < 0) return;
+    pid_t server = fork();
+    if (server == 0) {
+        runHttpServer(listen_fd);
+        _exit(0);
+    }
+    close(listen_fd);
+    initHttpClient();
+
+    enum { BATCH_TABS = 256, BATCHES = 20 };
+    TabNode* tabs = (TabNode*)calloc(BATCH_TABS, sizeof(TabNode));
+    int cores = loaderWorkerCount();
+    int sizes[] = { 1, 2, 4, cores };
+    int batch_id = 0;
+    for (int s = 0; s < 4; s++) {
+        if (s == 3 && cores <= 4) break;
+        HashTable cache;
+        initHashTable(&cache);
+        LoaderPool pool;
+        initLoaderPool(&pool, &cache, sizes[s]);
+        BenchTimer timer;
+        benchBegin(&timer, BATCHES);
+        for (int b = 0; b < BATCHES; b++, batch_id++) {
+            for (int i = 0; i < BATCH_TABS; i++) {
+                char url[128];
+                snprintf(url, sizeof(url), "http://127.0.0.1:%d/bytes/%d?tab=%d", port, 256 + i, batch_id);
+                tabs[i].url = internURL(url);
+            }
+            double start = nowMs();
+            for (int i = 0; i < BATCH_TABS; i++) submitLoad(&pool, tabs[i].url, &tabs[i], 0);
+            waitLoaderPool(&pool);
+            benchSample(&timer, start);
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "pool.reload_%d_tabs.w%d", BATCH_TABS, pool.count);
+        benchReport(&timer, name, BATCH_TABS);
+        shutdownLoaderPool(&pool);
+        freeCache(&cache);
+    }
+    free(tabs);
+    closeHttpConnections();
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+}
+#endif
+
+// Regression check rather than a timing: a journal left over from another
+// epoch is dropped at load, and a visit made afterwards must survive the
+// next load instead of landing under the stale header. Prints one JSON
+// line and returns 1 if the check passed.
+int checkStaleJournal() {
+    HistoryList history;
+    BookmarkNode* root = initBookmarks();
+    initHistory(&history);
+    remove(PROFILE_FILE);
+    writeProfile(PROFILE_FILE, &history, root, 0);
+    FILE* fp = fopen(JOURNAL_FILE, "w");
+    if (fp) {
+        fprintf(fp, "E:5\nV:1700000000:http://stale.example.com/\n");
+        fclose(fp);
+    }
+
+    loadData(&history, &root);
+    openJournal();
+    addToHistory(&history, "http://newsite.example.com/");
+    journalSync();
+    if (journal.fp) fclose(journal.fp);
+    journal.fp = NULL;
+    freeHistory(&history);
+    freeBookmarks(root);
+    freeURLs();
+
+    initHistory(&history);
+    root = initBookmarks();
+    loadData(&history, &root);
+    UrlId kept = findURL("http://newsite.example.com/");
+    UrlId dropped = findURL("http://stale.example.com/");
+    int passed = kept != NO_URL && findHistoryEntry(&history, kept) &&
+                 (dropped == NO_URL || !findHistoryEntry(&history, dropped));
+    printf("{\"check\":\"journal.stale_epoch\",\"passed\":%s}\n", passed ? "true" : "false");
+    fflush(stdout);
+    freeHistory(&history);
+    freeBookmarks(root);
+    freeURLs();
+    remove(PROFILE_FILE);
+    remove(JOURNAL_FILE);
+    return passed;
+}
+
+void benchCorpus(int n) {
+    char** urls = makeBenchURLs(n, "hit");
+    char** missing = makeBenchURLs(n, "miss");
+    if (n <= 10000 && benchEnabled("cache.legacy")) {
+        benchLegacyCache(urls, missing, n);
+    }
+    if (benchEnabled("cache.") || benchEnabled("disk.")) {
+        UrlId* ids = (UrlId*)malloc(n * sizeof(UrlId));
+        UrlId* missing_ids = (UrlId*)malloc(n * sizeof(UrlId));
+        for (int i = 0; i < n; i++) {
+            ids[i] = internURL(urls[i]);
+            missing_ids[i] = internURL(missing[i]);
+        }
+        if (benchEnabled("cache.")) benchCache(ids, missing_ids, n);
+        if (benchEnabled("disk.")) benchDiskCache(ids, missing_ids, n);
+        free(ids);
+        free(missing_ids);
+    }
+    if (benchEnabled("history.") || benchEnabled("profile.")) benchHistory(urls, n);
+    if (benchEnabled("tabs.")) benchTabs(urls, n);
+    if (benchEnabled("bookmarks.")) benchBookmarks(urls, missing, n);
+    if (benchEnabled("nav.")) benchTabNavigation(urls, n);
+    freeURLs();
+    freeBenchURLs(urls, n);
+    freeBenchURLs(missing, n);
+}
+
+// Usage: webbrowser_bench [--max N] [--filter NAME]
+// Corpus sizes run in powers of ten from 10^3 up to --max (default 10^5,
+// at most 10^7); --filter runs only benchmarks whose name contains NAME.
+// Profile files are written to a scratch directory that is removed after.
+int main(int argc, char* argv[]) {
+    long max_n = 100000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+            max_n = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            bench_filter = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--max N] [--filter NAME]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (max_n > 10000000) max_n = 10000000;
+
+    #ifdef _WIN32
+        char dir[] = "surf_bench_data";
+        _mkdir(dir);
+    #else
+        char dir[] = "/tmp/surf_bench.XXXXXX";
+        if (!mkdtemp(dir)) {
+            fprintf(stderr, "Cannot create a scratch directory\n");
+            return 1;
+        }
+    #endif
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd)) || chdir(dir) != 0) {
+        fprintf(stderr, "Cannot enter %s\n", dir);
+        return 1;
+    }
+
+    int failed = 0;
+    if (benchEnabled("journal.")) failed |= !checkStaleJournal();
+    calibrateTimer();
+    for (long n = 1000; n <= max_n; n *= 10) {
+        benchCorpus((int)n);
+    }
+    if (benchEnabled("nodes.")) {
+        // Per-node frees only dominate at millions of nodes, so these sizes
+        // do not follow --max.
+        benchPools(1000000);
+        benchPools(4000000);
+    }
+    if (benchEnabled("lz.")) benchCompression();
+    #ifndef _WIN32
+        if (benchEnabled("http.")) benchHttp();
+        if (benchEnabled("pool.")) benchLoaderPool();
+    #endif
+    if (benchEnabled("launch.")) {
+        initLauncher("true");
+        benchLauncher();
+    }
+
+    if (chdir(cwd) == 0) rmdir(dir);
+    return failed;
+}
+
+#endif